@@ -177,6 +177,16 @@ char *do_browser(char *path)
 	} else if (func == do_research) {
 	    /* Search for another filename. */
 	    do_fileresearch();
+	} else if (func == do_jump_void) {
+	    int row, col;
+
+	    /* Select one of the shown filenames by its label.  The labels
+	     * are counted out from the cursor, so put it on the selected
+	     * filename first. */
+	    if (browser_shown_name(selected % (editwinrows * width),
+				&row, &col) != NULL)
+		wmove(edit, row, col);
+	    do_jump_void();
 	} else if (func == do_left) {
 	    if (selected > 0)
 		selected--;
@@ -635,6 +645,28 @@ void browser_refresh(void)
     wnoutrefresh(edit);
 }
 
+/* Return the name (minus the path) of the nth filename that is shown on
+ * the screen, and set row and col to where it is shown.  Return NULL when
+ * fewer filenames are shown. */
+const char *browser_shown_name(size_t n, int *row, int *col)
+{
+    size_t first = selected - selected % (editwinrows * width);
+
+    if (n >= editwinrows * width || first + n >= filelist_len)
+	return NULL;
+
+    *row = n / width;
+    *col = (n % width) * (longest + 2);
+
+    return tail(filelist[first + n]);
+}
+
+/* Select the nth filename that is shown on the screen. */
+void browser_select_shown(size_t n)
+{
+    selected = selected - selected % (editwinrows * width) + n;
+}
+
 /* Look for needle.  If we find it, set selected to its location.
  * Note that needle must be an exact match for a file in the list. */
 void browser_select_dirname(const char *needle)
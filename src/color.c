@@ -308,23 +308,21 @@ void check_the_multis(filestruct *line)
 	if (ink->end == NULL)
 	    continue;
 
-	alloc_multidata_if_needed(line);
-
 	astart = (regexec(ink->start, line->data, 1, &startmatch, 0) == 0);
 	anend = (regexec(ink->end, line->data, 1, &endmatch, 0) == 0);
 
 	/* Check whether the multidata still matches the current situation. */
-	if (line->multidata[ink->id] == CNONE ||
-			line->multidata[ink->id] == CWHOLELINE) {
+	if (multi_state(line, ink->id) == CNONE ||
+			multi_state(line, ink->id) == CWHOLELINE) {
 	    if (!astart && !anend)
 		continue;
-	} else if (line->multidata[ink->id] == CSTARTENDHERE) {
+	} else if (multi_state(line, ink->id) == CSTARTENDHERE) {
 	    if (astart && anend && startmatch.rm_so < endmatch.rm_so)
 		continue;
-	} else if (line->multidata[ink->id] == CBEGINBEFORE) {
+	} else if (multi_state(line, ink->id) == CBEGINBEFORE) {
 	    if (!astart && anend)
 		continue;
-	} else if (line->multidata[ink->id] == CENDAFTER) {
+	} else if (multi_state(line, ink->id) == CENDAFTER) {
 	    if (astart && !anend)
 		continue;
 	}
@@ -335,17 +333,27 @@ void check_the_multis(filestruct *line)
     }
 }
 
-/* Allocate (for one line) the cache space for multiline color regexes. */
-void alloc_multidata_if_needed(filestruct *fileptr)
+/* Return how the multiline regex with the given id applies to the given
+ * line, or zero when this is not known. */
+short multi_state(const filestruct *line, int id)
 {
-    int i;
+    if (id >= MAX_CACHED_MULTIS)
+	return 0;
 
-    if (fileptr->multidata == NULL) {
-	fileptr->multidata = (short *)nmalloc(openfile->syntax->nmultis * sizeof(short));
+    return (line->multidata >> (id * MULTI_BITS)) & ((1 << MULTI_BITS) - 1);
+}
 
-	for (i = 0; i < openfile->syntax->nmultis; i++)
-	    fileptr->multidata[i] = -1;
-    }
+/* Record how the multiline regex with the given id applies to the given
+ * line -- if the cache of the line has room for that regex. */
+void set_multi_state(filestruct *line, int id, short state)
+{
+    unsigned int mask = (1 << MULTI_BITS) - 1;
+
+    if (id >= MAX_CACHED_MULTIS)
+	return;
+
+    line->multidata &= ~(mask << (id * MULTI_BITS));
+    line->multidata |= (unsigned int)state << (id * MULTI_BITS);
 }
 
 /* Precalculate the multi-line start and end regex info so we can
@@ -371,13 +379,12 @@ void precalc_multicolorinfo(void)
 	for (line = openfile->fileage; line != NULL; line = line->next) {
 	    int index = 0;
 
-	    alloc_multidata_if_needed(line);
 	    /* Assume nothing applies until proven otherwise below. */
-	    line->multidata[ink->id] = CNONE;
+	    set_multi_state(line, ink->id, CNONE);
 
 	    /* For an unpaired start match, mark all remaining lines. */
-	    if (line->prev && line->prev->multidata[ink->id] == CWOULDBE) {
-		line->multidata[ink->id] = CWOULDBE;
+	    if (line->prev && multi_state(line->prev, ink->id) == CWOULDBE) {
+		set_multi_state(line, ink->id, CWOULDBE);
 		continue;
 	    }
 
@@ -392,7 +399,7 @@ void precalc_multicolorinfo(void)
 		 * continue looking for other starts after it. */
 		if (regexec(ink->end, line->data + index, 1,
 			&endmatch, (index == 0) ? 0 : REG_NOTBOL) == 0) {
-		    line->multidata[ink->id] = CSTARTENDHERE;
+		    set_multi_state(line, ink->id, CSTARTENDHERE);
 		    index += endmatch.rm_eo;
 		    /* If both start and end are mere anchors, step ahead. */
 		    if (startmatch.rm_so == startmatch.rm_eo &&
@@ -415,21 +422,19 @@ void precalc_multicolorinfo(void)
 		}
 
 		if (tailline == NULL) {
-		    line->multidata[ink->id] = CWOULDBE;
+		    set_multi_state(line, ink->id, CWOULDBE);
 		    break;
 		}
 
 		/* We found it, we found it, la la la la la.  Mark all
 		 * the lines in between and the end properly. */
-		line->multidata[ink->id] = CENDAFTER;
+		set_multi_state(line, ink->id, CENDAFTER);
 
 		for (line = line->next; line != tailline; line = line->next) {
-		    alloc_multidata_if_needed(line);
-		    line->multidata[ink->id] = CWHOLELINE;
+		    set_multi_state(line, ink->id, CWHOLELINE);
 		}
 
-		alloc_multidata_if_needed(tailline);
-		tailline->multidata[ink->id] = CBEGINBEFORE;
+		set_multi_state(tailline, ink->id, CBEGINBEFORE);
 
 		/* Begin looking for a new start after the end match. */
 		index = endmatch.rm_eo;
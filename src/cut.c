@@ -52,7 +52,7 @@ void cut_line(void)
 		openfile->current->next, 0);
     else
 	extract_buffer(&cutbuffer, &cutbottom, openfile->current, 0,
-		openfile->current, strlen(openfile->current->data));
+		openfile->current, line_length(openfile->current));
     openfile->placewewant = 0;
 }
 
@@ -79,7 +79,7 @@ void cut_marked(bool *right_side_up)
  * newline used to be. */
 void cut_to_eol(void)
 {
-    size_t data_len = strlen(openfile->current->data);
+    size_t data_len = line_length(openfile->current);
 
     if (openfile->current_x < data_len)
 	/* If we're not at the end of the line, move all the text from
@@ -170,6 +170,8 @@ void do_cut_text(bool copy_text, bool cut_till_eof)
 	 * uncuts the text we just cut. */
 	if (cutbuffer != NULL) {
 	    if (cb_save != NULL) {
+		/* Melding the copy in gives its first line a text of its
+		 * own, so it does not keep pointing into cb_save's text. */
 		cb_save->data += cb_save_len;
 		copy_from_buffer(cb_save);
 		cb_save->data -= cb_save_len;
@@ -223,9 +225,9 @@ void do_copy_text(void)
     bool mark_set = openfile->mark_set;
 
     /* Remember the current viewport and cursor position. */
-    ssize_t is_edittop_lineno = openfile->edittop->lineno;
+    ssize_t is_edittop_lineno = line_number(openfile->edittop);
     size_t is_firstcolumn = openfile->firstcolumn;
-    ssize_t is_current_lineno = openfile->current->lineno;
+    ssize_t is_current_lineno = line_number(openfile->current);
     size_t is_current_x = openfile->current_x;
 
     if (mark_set || openfile->current != next_contiguous_line)
@@ -257,7 +259,7 @@ void do_cut_till_eof(void)
 /* Copy text from the cutbuffer into the current buffer. */
 void do_uncut_text(void)
 {
-    ssize_t was_lineno = openfile->current->lineno;
+    ssize_t was_lineno = line_number(openfile->current);
 	/* The line number where we started the paste. */
     size_t was_leftedge = 0;
 	/* The leftedge where we started the paste. */
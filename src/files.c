@@ -32,6 +32,12 @@
 #include <pwd.h>
 #endif
 #include <libgen.h>
+#ifdef USING_MMAP
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 
 #define LOCKBUFSIZE 8192
 
@@ -87,6 +93,11 @@ void make_new_buffer(void)
 
     openfile->filename = mallocstrcpy(NULL, "");
 
+    openfile->lineindex = NULL;
+    openfile->index_size = 0;
+    openfile->shifts = NULL;
+    openfile->shift_base = 1;
+
     initialize_buffer_text();
 
     openfile->placewewant = 0;
@@ -107,6 +118,11 @@ void make_new_buffer(void)
 
     openfile->current_stat = NULL;
     openfile->lock_filename = NULL;
+
+    openfile->anchors = NULL;
+    openfile->anchor_first = 0;
+    openfile->anchor_count = 0;
+    openfile->anchor_here = 0;
 #endif
 #ifndef DISABLE_COLOR
     openfile->syntax = NULL;
@@ -124,6 +140,10 @@ void initialize_buffer_text(void)
     openfile->edittop = openfile->fileage;
     openfile->current = openfile->fileage;
 
+    openfile->index_count = 0;
+    openfile->shift_count = 0;
+    openfile->fileage->epoch = openfile->shift_base;
+
     openfile->firstcolumn = 0;
     openfile->current_x = 0;
     openfile->totsize = 0;
@@ -540,6 +560,12 @@ void replace_buffer(const char *filename)
     free_filestruct(openfile->fileage);
     initialize_buffer_text();
 
+#ifndef NANO_TINY
+    /* The remembered positions pointed into the old text. */
+    openfile->anchor_count = 0;
+    openfile->anchor_here = 0;
+#endif
+
     /* Insert the processed file into its place. */
     read_file(f, descriptor, filename, FALSE, TRUE);
 
@@ -592,7 +618,7 @@ void prepare_for_display(void)
     /* If there are multiline coloring regexes, and there is no
      * multiline cache data yet, precalculate it now. */
     if (openfile->syntax && openfile->syntax->nmultis > 0 &&
-		openfile->fileage->multidata == NULL)
+		openfile->fileage->multidata == 0)
 	precalc_multicolorinfo();
 
     have_palette = FALSE;
@@ -616,6 +642,13 @@ void switch_to_prevnext_buffer(bool to_next)
     /* Switch to the next or previous file buffer. */
     openfile = to_next ? openfile->next : openfile->prev;
 
+    redecorate_after_switch();
+}
+
+/* Update the screen and the statusbar after openfile has been pointed
+ * at a different file buffer. */
+void redecorate_after_switch(void)
+{
 #ifdef DEBUG
     fprintf(stderr, "filename is %s\n", openfile->filename);
 #endif
@@ -668,7 +701,7 @@ bool close_buffer(void)
 #ifndef DISABLE_HISTORIES
     if (ISSET(POS_HISTORY))
 	update_poshistory(openfile->filename,
-			openfile->current->lineno, xplustabs() + 1);
+			line_number(openfile->current), xplustabs() + 1);
 #endif
 
     /* Switch to the next file buffer. */
@@ -725,14 +758,118 @@ int is_file_writable(const char *filename)
 }
 
 /* Encode any NUL bytes in the given line of text, which is of length buf_len,
- * and return a dynamically allocated copy of the resultant string. */
-char *encode_data(char *buf, size_t buf_len)
+ * and store a copy of the resultant string as the text of the given line. */
+void encode_data(filestruct *line, char *buf, size_t buf_len)
 {
     unsunder(buf, buf_len);
     buf[buf_len] = '\0';
 
-    return mallocstrcpy(NULL, buf);
+    set_text(line, buf);
+}
+
+#ifdef USING_MMAP
+/* Make the given text of the given length, which lies in a file mapping,
+ * the text of the given bottom line, and add a new line after it. */
+static void map_line(filestruct **bottomline, char *text, size_t length)
+{
+    /* Encode any NUL bytes, and terminate the text in place. */
+    if (memchr(text, '\0', length) != NULL)
+	unsunder(text, length);
+    text[length] = '\0';
+
+    (*bottomline)->data = text;
+    if (length < NOT_KNOWN)
+	(*bottomline)->length = length;
+
+    (*bottomline)->next = make_new_node(*bottomline);
+    *bottomline = (*bottomline)->next;
+}
+
+/* Read the given open file in one go into a memory mapping of its own,
+ * and make lines whose text lies in that mapping, from *bottomline on,
+ * converting DOS and Mac line endings the same way read_file() does.  Any
+ * final line that lacks a newline is copied into *buf instead, with its
+ * length in *len.  Return FALSE when the file cannot be read this way. */
+static bool read_mapped_file(FILE *f, filestruct **bottomline,
+	size_t *num_lines, int *format, char **buf, size_t *len)
+{
+    struct stat fileinfo;
+    char *map, *start, *stop, *end, *eol, *cr;
+    size_t size, got = 0, lines_before = *num_lines;
+    ssize_t chunk;
+
+    if (fstat(fileno(f), &fileinfo) == -1 || !S_ISREG(fileinfo.st_mode) ||
+		fileinfo.st_size == 0 || ftello(f) != 0 ||
+		(off_t)(size_t)fileinfo.st_size != fileinfo.st_size)
+	return FALSE;
+
+    /* The mapping is anonymous rather than of the file itself: the text
+     * needs its newlines turned into NULs anyway, and a file mapping would
+     * fault as soon as the file got truncated, for instance when saving
+     * over it. */
+    size = fileinfo.st_size;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+						-1, 0);
+    if (map == MAP_FAILED)
+	return FALSE;
+
+    /* Read without moving the file position, so that in case of trouble
+     * the file can still be read in the normal way. */
+    while (got < size && (chunk = pread(fileno(f), map + got,
+						size - got, got)) > 0)
+	got += chunk;
+
+    if (got < size) {
+	munmap(map, size);
+	return FALSE;
+    }
+
+    start = map;
+    end = map + size;
+
+    while (start < end) {
+	eol = memchr(start, '\n', end - start);
+	stop = (eol != NULL) ? eol : end;
+
+	/* In a Mac file, any carriage return that is not the last character
+	 * before the newline ends a line. */
+	while (!ISSET(NO_CONVERT) && (*num_lines == 0 || *format != 0) &&
+		stop - start > 1 &&
+		(cr = memchr(start, '\r', stop - start - 1)) != NULL) {
+	    if (*format == 0 || *format == 1)
+		*format += 2;
+	    map_line(bottomline, start, cr - start);
+	    (*num_lines)++;
+	    start = cr + 1;
+	}
+
+	/* Leave the final line without a newline to the caller. */
+	if (eol == NULL) {
+	    *len = stop - start;
+	    *buf = charealloc(*buf, *len + 1);
+	    memcpy(*buf, start, *len);
+	    break;
+	}
+
+	/* Strip a carriage return before the newline, and when the format
+	 * is still being determined, note that this is a DOS line. */
+	if (!ISSET(NO_CONVERT) && stop > start && stop[-1] == '\r') {
+	    if ((*num_lines == 0 || *format != 0) &&
+			(*format == 0 || *format == 2))
+		(*format)++;
+	    stop--;
+	}
+
+	map_line(bottomline, start, stop - start);
+	(*num_lines)++;
+	start = eol + 1;
+    }
+
+    adopt_mapping(map, size, *num_lines - lines_before);
+
+    return TRUE;
 }
+#endif /* USING_MMAP */
 
 /* Read an open file into the current buffer.  f should be set to the
  * open file, and filename should be set to the name of the file.
@@ -742,7 +879,7 @@ char *encode_data(char *buf, size_t buf_len)
 void read_file(FILE *f, int fd, const char *filename, bool undoable,
 		bool checkwritable)
 {
-    ssize_t was_lineno = openfile->current->lineno;
+    ssize_t was_lineno = line_number(openfile->current);
 	/* The line number where we start the insertion. */
     size_t was_leftedge = 0;
 	/* The leftedge where we start the insertion. */
@@ -784,7 +921,13 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable,
     topline = make_new_node(NULL);
     bottomline = topline;
 
+#ifdef USING_MMAP
+    /* Read the entire file into the new buffer -- directly from memory
+     * when the file can be mapped, otherwise one character at a time. */
+    if (!read_mapped_file(f, &bottomline, &num_lines, &format, &buf, &len))
+#else
     /* Read the entire file into the new buffer. */
+#endif
     while ((input_int = getc(f)) != EOF) {
 	input = (char)input_int;
 
@@ -836,7 +979,7 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable,
 #endif
 
 	/* Store the data and make a new line. */
-	bottomline->data = encode_data(buf, len);
+	encode_data(bottomline, buf, len);
 	bottomline->next = make_new_node(bottomline);
 	bottomline = bottomline->next;
 	num_lines++;
@@ -864,7 +1007,7 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable,
     /* If the file ended with newline, or it was entirely empty, make the
      * last line blank.  Otherwise, put the last read data in. */
     if (len == 0)
-	bottomline->data = mallocstrcpy(NULL, "");
+	set_text(bottomline, "");
     else {
 	bool mac_line_needs_newline = FALSE;
 
@@ -884,13 +1027,13 @@ void read_file(FILE *f, int fd, const char *filename, bool undoable,
 	}
 #endif
 	/* Store the data of the final line. */
-	bottomline->data = encode_data(buf, len);
+	encode_data(bottomline, buf, len);
 	num_lines++;
 
 	if (mac_line_needs_newline) {
 	    bottomline->next = make_new_node(bottomline);
 	    bottomline = bottomline->next;
-	    bottomline->data = mallocstrcpy(NULL, "");
+	    set_text(bottomline, "");
 	}
     }
 
@@ -1104,7 +1247,7 @@ void do_insertfile(void)
 	    statusbar(_("Cancelled"));
 	    break;
 	} else {
-	    ssize_t was_current_lineno = openfile->current->lineno;
+	    ssize_t was_current_lineno = line_number(openfile->current);
 	    size_t was_current_x = openfile->current_x;
 #if !defined(NANO_TINY) || defined(ENABLE_BROWSER) || defined(ENABLE_MULTIBUFFER)
 	    functionptrtype func = func_from_key(&i);
@@ -1193,7 +1336,7 @@ void do_insertfile(void)
 #endif /* ENABLE_MULTIBUFFER */
 	    {
 		/* Mark the file as modified if it changed. */
-		if (openfile->current->lineno != was_current_lineno ||
+		if (line_number(openfile->current) != was_current_lineno ||
 			openfile->current_x != was_current_x)
 		    set_modified();
 
@@ -1580,17 +1723,25 @@ int copy_file(FILE *inn, FILE *out, bool close_out)
  * If method is PREPEND, it means we are prepending instead of
  * overwriting.  If nonamechange is TRUE, we don't change the current
  * filename.  nonamechange is irrelevant when appending or prepending,
- * or when writing a temporary file.
+ * or when writing a temporary file.  If range isn't NULL, we write only
+ * the text in that range, ending it with a newline when needed, instead
+ * of the whole buffer.
  *
  * Return TRUE on success or FALSE on error. */
 bool write_file(const char *name, FILE *f_open, bool tmp,
-	kind_of_writing_type method, bool nonamechange)
+	kind_of_writing_type method, bool nonamechange,
+	const rangestruct *range)
 {
     bool retval = FALSE;
 	/* Instead of returning in this function, you should always
 	 * set retval and then goto cleanup_and_exit. */
     size_t lineswritten = 0;
-    const filestruct *fileptr = openfile->fileage;
+    rangestruct whole;
+	/* The range that covers the whole buffer. */
+    bool add_newline = (range != NULL && !ISSET(NO_NEWLINES));
+	/* Whether to end a range that doesn't end in a blank line with
+	 * a newline, as if it ended in a magicline. */
+    const filestruct *fileptr;
     int fd;
 	/* The file descriptor we use. */
     mode_t original_umask = 0;
@@ -1899,31 +2050,45 @@ bool write_file(const char *name, FILE *f_open, bool tmp,
 	}
     }
 
-    while (fileptr != NULL) {
-	size_t data_len = strlen(fileptr->data), size;
+    if (range == NULL) {
+	whole.top = openfile->fileage;
+	whole.top_x = 0;
+	whole.bot = openfile->filebot;
+	whole.bot_x = strlen(openfile->filebot->data);
+	range = &whole;
+    }
+
+    fileptr = range->top;
+
+    while (TRUE) {
+	char *text = fileptr->data + ((fileptr == range->top) ?
+						range->top_x : 0);
+	size_t data_len = strlen(text), size;
+	size_t write_len = (fileptr == range->bot) ?
+		range->bot_x - (text - fileptr->data) : data_len;
 
 	/* Convert newlines to nulls, just before we write to disk. */
-	sunder(fileptr->data);
+	sunder(text);
 
-	size = fwrite(fileptr->data, sizeof(char), data_len, f);
+	size = fwrite(text, sizeof(char), write_len, f);
 
 	/* Convert nulls to newlines.  data_len is the string's real
 	 * length. */
-	unsunder(fileptr->data, data_len);
+	unsunder(text, data_len);
 
-	if (size < data_len) {
+	if (size < write_len) {
 	    statusline(ALERT, _("Error writing %s: %s"), realname,
 			strerror(errno));
 	    fclose(f);
 	    goto cleanup_and_exit;
 	}
 
-	/* If we're on the last line of the file, don't write a newline
-	 * character after it.  If the last line of the file is blank,
-	 * this means that zero bytes are written, in which case we
-	 * don't count the last line in the total lines written. */
-	if (fileptr == openfile->filebot) {
-	    if (fileptr->data[0] == '\0')
+	/* If we're on the last line of the range, don't write a newline
+	 * character after it, unless a range needs one.  If the last line
+	 * is blank, this means that zero bytes are written, in which case
+	 * we don't count the last line in the total lines written. */
+	if (fileptr == range->bot && (write_len == 0 || !add_newline)) {
+	    if (write_len == 0)
 		lineswritten--;
 	} else {
 #ifndef NANO_TINY
@@ -1946,8 +2111,12 @@ bool write_file(const char *name, FILE *f_open, bool tmp,
 		}
 	}
 
-	fileptr = fileptr->next;
 	lineswritten++;
+
+	if (fileptr == range->bot)
+	    break;
+
+	fileptr = fileptr->next;
     }
 
     /* If we're prepending, open the temp file, and append it to f. */
@@ -2002,10 +2171,8 @@ bool write_file(const char *name, FILE *f_open, bool tmp,
 
 	    /* If the syntax changed, discard and recompute the multidata. */
 	    if (strcmp(oldname, newname) != 0) {
-		for (; line != NULL; line = line->next) {
-		    free(line->multidata);
-		    line->multidata = NULL;
-		}
+		for (; line != NULL; line = line->next)
+		    line->multidata = 0;
 		precalc_multicolorinfo();
 		refresh_needed = TRUE;
 	    }
@@ -2042,31 +2209,12 @@ bool write_marked_file(const char *name, FILE *f_open, bool tmp,
     bool retval;
     bool old_modified = openfile->modified;
 	/* Save the status, because write_file() unsets the modified flag. */
-    bool added_magicline = FALSE;
-	/* Whether we added a magicline after filebot. */
-    filestruct *top, *bot;
-    size_t top_x, bot_x;
-
-    /* Partition the buffer so that it contains only the marked text. */
-    mark_order((const filestruct **)&top, &top_x,
-		(const filestruct **)&bot, &bot_x, NULL);
-    filepart = partition_filestruct(top, top_x, bot, bot_x);
-
-    /* If we are doing magicline, and the last line of the partition
-     * isn't blank, then add a newline at the end of the buffer. */
-    if (!ISSET(NO_NEWLINES) && openfile->filebot->data[0] != '\0') {
-	new_magicline();
-	added_magicline = TRUE;
-    }
-
-    retval = write_file(name, f_open, tmp, method, TRUE);
+    rangestruct marked;
 
-    /* If we added a magicline, remove it now. */
-    if (added_magicline)
-	remove_magicline();
+    /* Write just the marked text, straight from the buffer. */
+    mark_range(&marked);
 
-    /* Unpartition the buffer so that it contains all the text again. */
-    unpartition_filestruct(&filepart);
+    retval = write_file(name, f_open, tmp, method, TRUE, &marked);
 
     if (old_modified)
 	set_modified();
@@ -2098,7 +2246,8 @@ int do_writeout(bool exiting)
     as_an_at = FALSE;
 
     if (exiting && ISSET(TEMP_FILE) && openfile->filename[0] != '\0') {
-	if (write_file(openfile->filename, NULL, FALSE, OVERWRITE, FALSE))
+	if (write_file(openfile->filename, NULL, FALSE, OVERWRITE, FALSE,
+			NULL))
 	    return 1;
 	/* If writing the file failed, go on to prompt for a new name. */
     }
@@ -2303,7 +2452,7 @@ int do_writeout(bool exiting)
 		result = write_marked_file(answer, NULL, FALSE, method);
 	    else
 #endif
-		result = write_file(answer, NULL, FALSE, method, FALSE);
+		result = write_file(answer, NULL, FALSE, method, FALSE, NULL);
 
 	    break;
 	}
@@ -2327,7 +2476,7 @@ void do_writeout_void(void)
 void do_savefile(void)
 {
     if (openfile->filename[0] != '\0')
-	write_file(openfile->filename, NULL, FALSE, OVERWRITE, FALSE);
+	write_file(openfile->filename, NULL, FALSE, OVERWRITE, FALSE, NULL);
     else
 	do_writeout_void();
 }
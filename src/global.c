@@ -110,6 +110,9 @@ WINDOW *bottomwin = NULL;
 	 * messages, the statusbar prompt, and a list of shortcuts. */
 int editwinrows = 0;
 	/* How many rows does the edit window take up? */
+screenrow *screenmap = NULL;
+	/* For each row of the edit window, which part of which line was
+	 * last drawn there. */
 
 filestruct *cutbuffer = NULL;
 	/* The buffer where we store cut text. */
@@ -497,6 +500,14 @@ void shortcut_init(void)
      * they are best kept shorter than 56 characters, but may be longer. */
     const char *nano_cancel_msg = N_("Cancel the current function");
     const char *nano_jump_msg = N_("Enter jump-mode");
+#ifndef NANO_TINY
+    const char *nano_jumpselect_msg =
+	N_("Set the mark and enter jump-mode, to select up to the target");
+    const char *nano_anchorback_msg =
+	N_("Go back to where the cursor was before a jump");
+    const char *nano_anchorforward_msg =
+	N_("Go forward again to where a jump went");
+#endif
     const char *nano_help_msg = N_("Display this help text");
     const char *nano_exit_msg =
 #ifdef ENABLE_MULTIBUFFER
@@ -1045,12 +1056,26 @@ void shortcut_init(void)
 	N_("Next Lint Msg"), IFSCHELP(nano_nextlint_msg), TOGETHER, VIEW);
 #endif
 
-    add_to_funcs(do_jump_void, MMAIN,
+    add_to_funcs(do_jump_void, MMAIN|MHELP|MBROWSER,
 	N_("jump-mode"), IFSCHELP(nano_jump_msg), TOGETHER, VIEW);
+#ifndef NANO_TINY
+    add_to_funcs(do_jump_select_void, MMAIN,
+	N_("jump-select"), IFSCHELP(nano_jumpselect_msg), TOGETHER, VIEW);
+    add_to_funcs(do_anchor_back, MMAIN,
+	N_("jump-back"), IFSCHELP(nano_anchorback_msg), TOGETHER, VIEW);
+    add_to_funcs(do_anchor_forward, MMAIN,
+	N_("jump-forward"), IFSCHELP(nano_anchorforward_msg), TOGETHER, VIEW);
+#endif
 
     /* Start associating key combos with functions in specific menus. */
 
-    add_to_sclist(MMAIN, "^G", 0, do_jump_void, 0);
+    add_to_sclist(MMAIN|MBROWSER, "^G", 0, do_jump_void, 0);
+    add_to_sclist(MHELP, "M-J", 0, do_jump_void, 0);
+#ifndef NANO_TINY
+    add_to_sclist(MMAIN, "M-'", 0, do_jump_select_void, 0);
+    add_to_sclist(MMAIN, "M-;", 0, do_anchor_back, 0);
+    add_to_sclist(MMAIN, "M-:", 0, do_anchor_forward, 0);
+#endif
     add_to_sclist(MMOST & ~MFINDINHELP, "F1", 0, do_help_void, 0);
     add_to_sclist(MMAIN|MHELP|MBROWSER, "^X", 0, do_exit, 0);
     add_to_sclist(MMAIN|MHELP|MBROWSER, "F2", 0, do_exit, 0);
@@ -1430,6 +1455,12 @@ sc *strtosc(const char *input)
     else if (!strcasecmp(input, "jump"))
 	s->scfunc = do_jump_void;
 #ifndef NANO_TINY
+    else if (!strcasecmp(input, "jumpselect"))
+	s->scfunc = do_jump_select_void;
+    else if (!strcasecmp(input, "jumpback"))
+	s->scfunc = do_anchor_back;
+    else if (!strcasecmp(input, "jumpforward"))
+	s->scfunc = do_anchor_forward;
     else if (!strcasecmp(input, "savefile"))
 	s->scfunc = do_savefile;
 #endif
@@ -194,8 +194,8 @@ void do_help(void)
 	} else if (func == do_up_void) {
 	    do_up(TRUE);
 	} else if (func == do_down_void) {
-	    if (openfile->edittop->lineno + editwinrows - 1 <
-				openfile->filebot->lineno)
+	    if (line_number(openfile->edittop) + editwinrows - 1 <
+				line_number(openfile->filebot))
 		do_down(TRUE);
 	} else if (func == do_page_up) {
 	    do_page_up();
@@ -211,6 +211,17 @@ void do_help(void)
 	} else if (func == do_research) {
 	    do_research();
 	    currmenu = MHELP;
+	} else if (func == do_jump_void) {
+	    filestruct *was_current = openfile->current;
+	    size_t was_current_x = openfile->current_x;
+
+	    do_jump_void();
+	    bottombars(MHELP);
+
+	    /* If the jump went somewhere, let the cursor show where. */
+	    if (openfile->current != was_current ||
+			openfile->current_x != was_current_x)
+		didfind = 1;
 #ifndef NANO_TINY
 	} else if (kbinput == KEY_WINCH) {
 	    ; /* Nothing to do. */
@@ -582,6 +593,9 @@ functionptrtype parse_help_input(int *kbinput)
 	    case 'N':
 	    case 'n':
 		return do_research;
+	    case 'J':
+	    case 'j':
+		return do_jump_void;
 	    case 'E':
 	    case 'e':
 	    case 'Q':
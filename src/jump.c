@@ -27,6 +27,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#ifdef DEBUG
+#include <time.h>
+#endif
 
 // TODO:
 // * implement dimming of non-highlight chars
@@ -34,6 +37,8 @@
 
 static char *default_label_chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 char *jump_mode_label_chars = NULL;
+ssize_t jump_mode_radius = 0;
+ssize_t jump_mode_needle = 1;
 
 #ifdef DISABLE_COLOR
 static bool use_color = false;
@@ -45,36 +50,250 @@ static int highlight_color = COLOR_YELLOW;
 static attr_t color_highlight_attr = A_STANDOUT | COLOR_PAIR(1);
 static attr_t nocolor_highlight_attr = A_STANDOUT;
 
-static int max_depth = 10;
-typedef struct _node {
-	int y, x;
-	int line, col;
-	char c;
-	struct _node *next;
-} node_t;
+static size_t max_offscreen = 4096;
+
+// All candidates of a jump, kept as parallel arrays in one arena that
+// survives across invocations: it only ever grows (by doubling), so after
+// the first few jumps no allocation happens at all.  Cleaning up is
+// a reset of `count`.
+// The on-screen candidates come first; in whole-buffer mode they are
+// followed by the off-screen ones, nearest to the viewport first, and in
+// all-buffers mode by those in the other buffers, as far as scanned yet.
+typedef struct {
+	int *y, *x;         // where on the screen the label is drawn (-1 if off-screen)
+	int *line, *col;    // where in the buffer the candidate is
+	filestruct **lines; // the line itself, so that no list walking is needed
+	openfilestruct **files; // the buffer the line belongs to
+	size_t *index;      // the byte offset of the candidate in its line
+	size_t *label;      // the label as a number, whose digits in base
+	                    // strlen(jump_mode_label_chars) pick its characters
+	int *length;        // how many characters the label has (0 once ruled out)
+	size_t *order;      // scratch: the on-screen ones, nearest to the cursor first
+	size_t onscreen;    // how many of the candidates are on the screen
+	size_t count;       // the number of candidates in use
+	size_t capacity;    // the number of candidates there is room for
+} candidate_table;
+
+static candidate_table table = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, 0};
+
+// the buffer whose lines are being scanned for candidates
+static openfilestruct *scanned_file = NULL;
+
+// in all-buffers mode: the next other buffer to scan, or NULL when there is
+// none left; the other buffers are scanned only when their candidates are
+// asked for, so a jump costs what it shows, not what is open
+static openfilestruct *next_file = NULL;
+
+// the head, and the characters of the needle typed after it, so that the
+// candidates of a buffer scanned later can be sifted in the same way
+static char scanned_head[MAXCHARLEN + 1];
+static char needle_tail[64];
+static size_t tail_length = 0;
+
+// what a jump is after: the typed head character, or one of the kinds of
+// targets that are generated from the structure of the text
+typedef enum {
+	TARGET_CHAR,    // every (word-initial) occurrence of the head character
+	TARGET_LINE,    // the start of every line
+	TARGET_BRACKET, // every bracket of the matchbrackets set
+	TARGET_WORD,    // the start of every identifier
+	TARGET_MATCH    // every match of the last search
+} target_kind;
+
+static target_kind target = TARGET_CHAR;
+
+// whether the jump extends the mark to the target (jump-select)
+static bool selecting = false;
+
+// the menu jump-mode was entered from: in the help viewer just the lines
+// on the screen are targets, and in the file browser the shown filenames
+static int jump_menu = MMAIN;
+
+// the length of the longest label handed out
+static int label_depth = 0;
+
+// with a wide curses, the overlay keeps whole characters (also double-width
+// ones) together with their attributes; otherwise plain chtypes suffice
+#if defined(ENABLE_UTF8) && defined(NCURSES_WIDECHAR) && NCURSES_WIDECHAR
+#define OVERLAY_WIDE
+#endif
+
+// The overlay: the labels and marks of jump mode are painted straight into
+// the edit window, but every character they cover is first recorded here
+// (once, with its attributes), so that taking them away means putting back
+// just those characters -- no line of the window needs to be redrawn.
+typedef struct {
+	int y, x;           // the first column of the covered character
+#ifdef OVERLAY_WIDE
+	cchar_t cell;       // the character itself, with attributes and color
+#else
+	chtype cell;
+#endif
+} covered_cell;
+
+static covered_cell *covered = NULL;
+static size_t overlay_count = 0, overlay_capacity = 0;
+static size_t *overlay_at = NULL;   // per screen cell: 1 + its index in `covered`, or 0
+static int overlay_rows = 0, overlay_cols = 0;
+
+// where the cursor was when the labels were handed out
+static int cursor_y = 0, cursor_x = 0;
+
+#ifdef DEBUG
+// what the last jump cost (in processor time, so waiting for keys does not
+// count), reported on stderr when it ends; jumpcheck ("make check") shows
+// these lines next to each scripted jump
+static struct {
+	clock_t start;      // when the head character was read
+	clock_t scanned;    // when the candidates were collected (0: never)
+	int labelled;       // how many on-screen candidates got a label
+	int rounds;         // how many label characters had to be typed
+	size_t growths;     // how many times the candidate table had to grow
+} jump_stats;
+
+// print the counters of the jump that just ended
+static void report_jump(void);
+#endif
+
+// prompt for a single keystroke, listing the keys of the target generators
+// too when `generators` is set; return it, or -1 when cancelled
+static int do_key_prompt(const char *msg, bool generators);
 
 // prompt for a single character of input (submits automatically)
 char do_char_prompt(const char *msg);
 
-// construct a copy of `node` and insert into the given linked-list
-void emplace(node_t *node, node_t **head_ptr, node_t **tail_ptr);
+// ask for the head character, which may be a multibyte one, and store it
+// in `head` (folded to lowercase when it is ASCII); return its first byte,
+// or '\0' when cancelled and '\1' when the character is unprintable; one of
+// the keys of the target generators instead sets `target`, and gives '\2'
+static char read_head_char(char *head);
+
+// make room for at least `needed` candidates in the table
+static void table_reserve(size_t needed);
+
+// append a candidate to the table (without a label yet)
+static void table_add(int y, int x, filestruct *line_ptr, size_t index, int col);
+
+// whether the `pos`th character after the head of candidate `i` is `c`
+static bool table_keeps(size_t i, size_t pos, char c);
+
+// move candidate `from` down to the slot `to`
+static void table_move(size_t to, size_t from);
+
+// keep only the candidates whose `pos`th character after the head is `c`
+// (in any case), preserving their order; return how many are left
+static size_t table_filter(size_t pos, char c);
+
+#ifdef ENABLE_MULTIBUFFER
+// sift the candidates from `from` on through the needle typed so far
+static void table_sift(size_t from);
+#endif
+
+// give the on-screen candidates a prefix-free set of labels, the nearest
+// to the cursor getting the shortest: with k label characters, n targets
+// need at most ceil(log_k n) keystrokes; return the longest label length
+static int assign_labels(void);
+
+// the character at position `pos` of the label of candidate `i`
+static char label_char(size_t i, int pos);
+
+// draw the label of candidate `i`, or put back what it covers
+static void draw_label(WINDOW *win, size_t i);
+static void erase_label(WINDOW *win, size_t i);
+
+// rule out the labels that do not have `key` at position `pos`, updating
+// the screen for just those; return how many candidates are left
+static size_t rule_out(WINDOW *win, int pos, char key);
+
+// record the character under the given cell of the window, unless it is
+// recorded already; this must happen before anything is painted over it
+static void overlay_save(WINDOW *win, int y, int x);
+
+// paint `c` (or, when `c` is zero, the character that is there) with
+// the given attributes over an already saved cell
+static void overlay_paint(WINDOW *win, int y, int x, char c, attr_t attr);
+
+// put back the character that covers the given saved cell
+static void overlay_restore(WINDOW *win, int y, int x);
+
+// put back all recorded characters, and forget them
+static void overlay_clear(WINDOW *win);
+
+// the length in bytes of the character at `at`, adding its width to `col`;
+// printable ASCII goes without asking the locale
+static int step_char(const char *at, size_t *col);
+
+// whether the character at `at` is the head character (in any case)
+static bool is_head(const char *at, const char *head);
+
+// whether the character at `at` is a letter or a digit
+static bool is_alnum_at(const char *at);
+
+// collect the candidates for `head` (or for the chosen kind of target) among
+// the bytes `start` up to `end` of the given line, in a single pass over
+// them; when `y` is not negative, these bytes were drawn on that
+// row from column `leftedge` on, and each candidate gets its cell -- except
+// when a "$" marker of a horizontally scrolled line hides it
+static void scan_line(filestruct *line_ptr, const char *head, size_t start, size_t end,
+                      int y, size_t leftedge);
+
+// collect the candidates for `head` on a line that is not on the screen
+static void collect_line(filestruct *line_ptr, const char *head);
+
+// collect the candidates for `head` outside of the edit window, alternating
+// between below and above it so that the nearest ones come first, within
+// `jump_mode_radius` lines (or the whole buffer when that is zero)
+static void collect_offscreen(const char *head);
+
+// in all-buffers mode, scan the region of the next other buffer that was on
+// the screen when that buffer was left, and sift its candidates through the
+// needle; return false when there was no buffer left to scan
+static bool collect_next_file(void);
 
-// highlight all occurences of `c` in the given window according to the
-// `label_chars` order. If a location is highlighted with the character
-// 'a', a new linked-list node will be emplaced into `heads[(location of
-// 'a' in label_chars)]`.
-int do_highlight_char(WINDOW *win, char c, node_t **heads, node_t **tails);
+// scan other buffers until the table holds at least `wanted` candidates,
+// or until all of them have been scanned
+static void collect_until(size_t wanted);
 
-// highlight all locations referred to by the nodes of `these`. New nodes will
-// be emplaced into the `heads` array as in `do_highlight_char`.
-int do_highlight_these(WINDOW *win, node_t *these, node_t **heads, node_t **tails);
+// page through the off-screen candidates on the status bar, and let the
+// user pick one; return its index in the table, or -1 when cancelled
+static ssize_t select_offscreen(void);
 
-// Restore all locations in the lists of `heads` to their original state and
-// delete the linked-list nodes.
-void cleanup_highlight(WINDOW *win, node_t **heads, node_t **tails);
+// find all occurences of `head` in the given window (and, in whole-buffer
+// mode, beyond it), and collect them in the candidate table
+static void collect_candidates(WINDOW *win, const char *head);
 
-// Move the cursor to the given line, col on screen (do not recenter the cursor)
-void move_cursor(ssize_t line, ssize_t column);
+#ifdef ENABLE_BROWSER
+// collect the filenames shown in the file browser that begin with `head`;
+// a candidate has no line, its index being the number of the filename
+// among those shown
+static void collect_shown_names(const char *head);
+#endif
+
+// let the user type the rest of the needle, a character at a time,
+// filtering the candidates after each; return false when cancelled
+static bool read_needle(const char *head);
+
+// the type-ahead sub-mode: mark the on-screen candidates, and let every
+// typed character narrow them down further, unmarking only the cells of
+// the ones that drop out, until one is left or Enter asks for labels;
+// return false when cancelled
+static bool type_ahead(WINDOW *win, const char *head);
+
+// find all occurences of `head` in the given window, collect them in the
+// candidate table, and label them.  Return the number of on-screen ones.
+int do_highlight_char(WINDOW *win, const char *head);
+
+// label and highlight all on-screen locations in the candidate table,
+// all in one go: typing a label later never needs another full round.
+int do_highlight_these(WINDOW *win);
+
+// Restore all locations in the candidate table to their original state.
+void cleanup_highlight(WINDOW *win);
+
+// Put the cursor on the candidate with the given index in the table, first
+// switching to its buffer when it is in another one.  As every candidate
+// knows its line and byte offset, this costs no walking.
+void jump_to_candidate(size_t index);
 
 // the main read-eval-jump loop:
 void do_jump(void) {
@@ -86,120 +305,209 @@ void do_jump(void) {
 		jump_mode_label_chars = default_label_chars;
 	}
 
-	char head_char = do_char_prompt(_("Head char: "));
-	head_char = tolower(head_char);
+	char head[MAXCHARLEN + 1];
+	char head_char = read_head_char(head);
+
+#ifdef DEBUG
+	memset(&jump_stats, 0, sizeof(jump_stats));
+	jump_stats.start = clock();
+#endif
 
 	if (head_char == '\0') {
 		statusbar(_("Cancelled"));
 		return;
-	} else if (head_char == '\1') {
+	} else if (head_char == '\1' || head_char == '\t') {
 		statusbar(_("jump-mode: Unprintable character"));
 		return;
 	} else if (head_char == ' ') {
 		statusbar(_("jump-mode: Don't support jumping to 'space'"));
 		return;
 	}
-	
-	// setup
-	node_t *heads[strlen(jump_mode_label_chars)];
-	node_t *tails[strlen(jump_mode_label_chars)];
-	node_t *saved_head = NULL, *saved_tail = NULL; // when we recurse on chars
-	for (int i = 0; i < strlen(jump_mode_label_chars); i++) {
-		heads[i] = NULL; tails[i] = NULL;
-	}
 
-	int num_highlighted;
-	int recursed = 0;
+	table.count = 0;
+	table.onscreen = 0;
 
-	int final_line = 0, final_col = 0;
+	if (target == TARGET_MATCH) {
+		// the matches are looked for forward, whatever the search direction
+		bool backwards = ISSET(BACKWARDS_SEARCH);
 
-	while (recursed < max_depth) {
-		// give choices to narrow on
-		if (!recursed) {
-			num_highlighted = do_highlight_char(edit, head_char, heads, tails);
-		} else {
-			num_highlighted = do_highlight_these(edit, saved_head, heads, tails);
-			while (saved_head != NULL) {
-				node_t *trash = saved_head;
-				saved_head = saved_head->next;
-				free(trash);
-			}
+		if (last_search[0] == '\0') {
+			statusbar(_("No current search pattern"));
+			return;
 		}
+		regexp_cleanup();
+		if (ISSET(USE_REGEXP) && !regexp_init(last_search)) { return; }
 
-		blank_statusbar();
-		
-		if (num_highlighted <= 0) { // picked a nonexistent char
-			cleanup_highlight(edit, heads, tails);
-			statusbar(_("jump-mode: No one found"));
+		UNSET(BACKWARDS_SEARCH);
+		collect_candidates(edit, head);
+		if (backwards) { SET(BACKWARDS_SEARCH); }
+		regexp_cleanup();
+#ifdef ENABLE_BROWSER
+	} else if (jump_menu == MBROWSER) {
+		collect_shown_names(head);
+#endif
+	} else {
+		collect_candidates(edit, head);
+	}
+#ifdef DEBUG
+	jump_stats.scanned = clock();
+#endif
+
+	// the generated targets (and the filenames) are labelled straight away
+	if (target == TARGET_CHAR && jump_menu != MBROWSER) {
+		collect_until(2);
+
+		if (ISSET(JUMP_TYPEAHEAD) ? !type_ahead(edit, head) : !read_needle(head)) {
+			statusbar(_("Cancelled"));
 			return;
 		}
-		
-		if (num_highlighted == 1) { // picked the only occurrence
-			if (!recursed) {
-				statusbar(_("jump-mode: One candidate, move to it directly"));
-			}
-			final_line = heads[0]->line;
-			final_col = heads[0]->col;
-			break;
-		}
+	}
+
+	int num_highlighted = do_highlight_these(edit);
+#ifdef DEBUG
+	jump_stats.labelled = num_highlighted;
+#endif
+	size_t num_offscreen = table.count - table.onscreen;
+	ssize_t final = -1;
+
+	blank_statusbar();
+
+	if (table.count == 0) { // picked a nonexistent char
+		statusbar(_("jump-mode: No one found"));
+		return;
+	}
+
+	if (table.count == 1) { // picked the only occurrence
+		statusbar(_("jump-mode: One candidate, move to it directly"));
+		final = 0;
+	} else if (num_highlighted == 0) { // everything is off-screen
+		final = select_offscreen();
+	}
 
-		// have to narrow down some more
-		char select_char = '\0';
-		select_char = do_char_prompt(_("Select: "));
+	// type the label of the target, one character at a time; the labels
+	// stay on the screen, only those that no longer fit are taken away
+	char typed[label_depth + 1];
+	int num_typed = 0;
+
+	while (final < 0 && num_highlighted > 0) {
+		char *msg;
+
+		typed[num_typed] = '\0';
+		if (next_file != NULL) { // other buffers may hold more
+			msg = charalloc(strlen(_("Select (Tab: %lu+ off-screen): ")) + 21 + num_typed);
+			sprintf(msg, _("Select (Tab: %lu+ off-screen): "), (unsigned long)num_offscreen);
+		} else if (num_offscreen > 0) {
+			msg = charalloc(strlen(_("Select (Tab: %lu off-screen): ")) + 21 + num_typed);
+			sprintf(msg, _("Select (Tab: %lu off-screen): "), (unsigned long)num_offscreen);
+		} else {
+			msg = charalloc(strlen(_("Select: ")) + 1 + num_typed);
+			strcpy(msg, _("Select: "));
+		}
+		strcat(msg, typed);
+		char select_char = do_char_prompt(msg);
+		free(msg);
 		blank_statusbar();
-		
+
 		if (select_char == '\0') { // user cancelled
-			cleanup_highlight(edit, heads, tails);
+			cleanup_highlight(edit);
 			statusbar(_("Cancelled"));
 			return;
 		}
 
-		// see what index the user picked
-		int list_idx = (int)(strchr(jump_mode_label_chars,
-		                            select_char) - jump_mode_label_chars);
-		if ((list_idx < 0) || (list_idx >= num_highlighted)) {
-			cleanup_highlight(edit, heads, tails);
+		if (select_char == '\t' && (num_offscreen > 0 || next_file != NULL)) {
+			cleanup_highlight(edit);
+			final = select_offscreen();
+			break;
+		}
+
+		if (rule_out(edit, num_typed, select_char) == 0) {
+			cleanup_highlight(edit);
 			statusbar(_("jump-mode: No such position candidate"));
 			return;
 		}
+		typed[num_typed++] = select_char;
+#ifdef DEBUG
+		jump_stats.rounds = num_typed;
+#endif
 
-		// get the list of chars corresponding to index
-		node_t *list = heads[list_idx];
-		if (num_highlighted > strlen(jump_mode_label_chars)) {
-			do { // back up the list before cleaning this hilite
-				emplace(list, &saved_head, &saved_tail);
-				list = list->next;
-			} while (list != NULL);
-			cleanup_highlight(edit, heads, tails);
-			
-			recursed++;
-			continue; // narrow down some more
-		} else { // got a final result
-			final_line = list->line;
-			final_col = list->col;
-			break;
+		// as the labels are prefix-free, a single one left is the target
+		for (size_t i = 0, left = 0; i < table.onscreen; i++) {
+			if (table.length[i] > 0) {
+				final = (left++ == 0) ? (ssize_t)i : -1;
+			}
 		}
 	}
-	
-	cleanup_highlight(edit, heads, tails);
-	if (ISSET(JUMP_CENTER)) {
-		do_gotolinecolumn(final_line, final_col + 1, false, false);
+
+	cleanup_highlight(edit);
+	if (final < 0) {
+		statusbar(_("Cancelled"));
+		return;
+	}
+
+#ifdef ENABLE_BROWSER
+	if (jump_menu == MBROWSER) {
+		browser_select_shown(table.index[final]);
+		return;
+	}
+#endif
+
+#ifndef NANO_TINY
+	// when selecting, the mark stays behind where the cursor was
+	if (selecting && !openfile->mark_set) {
+		do_mark();
+	}
+#endif
+
+	// the labels are gone already, so only the cursor needs redrawing
+	// (and the window, when the target was not on it or in this buffer);
+	// with the mark on, edit_redraw() repaints just the rows in between
+	openfilestruct *was_file = openfile;
+	filestruct *was_current = openfile->current;
+#ifndef NANO_TINY
+	if (jump_menu == MMAIN) {
+		push_anchor(openfile->current, openfile->current_x);
+	}
+#endif
+	jump_to_candidate(final);
+	if (openfile != was_file) {
+		refresh_needed = TRUE;
+	} else if (ISSET(JUMP_CENTER) && jump_menu == MMAIN && !selecting &&
+				(size_t)final < table.onscreen) {
+		refresh_needed = TRUE;
 	} else {
-		move_cursor(final_line, final_col + 1);
+		edit_redraw(was_current);
 	}
-	refresh_needed = TRUE;
 }
 
 void do_jump_void(void) {
+	if (currmenu == MMAIN || currmenu == MHELP || currmenu == MBROWSER) {
+		jump_menu = currmenu;
+		do_jump();
+		jump_menu = MMAIN;
+#ifdef DEBUG
+		report_jump();
+#endif
+	} else {
+		beep();
+	}
+}
+
+#ifndef NANO_TINY
+void do_jump_select_void(void) {
 	if (currmenu == MMAIN) {
+		selecting = true;
 		do_jump();
+		selecting = false;
+#ifdef DEBUG
+		report_jump();
+#endif
 	} else {
 		beep();
 	}
 }
+#endif
 
-char do_char_prompt(const char *msg) {
-	char response = '\0';
+static int do_key_prompt(const char *msg, bool generators) {
 	int width = 16;
 	char *message = display_string(msg, 0, COLS, FALSE);
 
@@ -217,6 +525,16 @@ char do_char_prompt(const char *msg) {
 
 		wmove(bottomwin, 1, 0);
 		onekey("^C", _("Cancel"), width);
+		if (generators) {
+			wmove(bottomwin, 2, 0);
+			onekey("^L", _("Lines"), width);
+			wmove(bottomwin, 1, width);
+			onekey("^B", _("Brackets"), width);
+			wmove(bottomwin, 2, width);
+			onekey("^W", _("Words"), width);
+			wmove(bottomwin, 1, 2 * width);
+			onekey("^F", _("Matches"), width);
+		}
 	}
 
 	/* Color the statusbar over its full width and display the question. */
@@ -227,183 +545,818 @@ char do_char_prompt(const char *msg) {
 
 	wnoutrefresh(bottomwin);
 
+	// a single update puts both the prompt and any pending labels on screen
+	doupdate();
+
 	currmenu = MYESNO;
 	kbinput = get_kbinput(bottomwin);
 
 	func = func_from_key(&kbinput);
 
-	if (func == do_cancel) {
-		response = '\0';
+	free(message);
+
+	return (func == do_cancel) ? -1 : kbinput;
+}
+
+char do_char_prompt(const char *msg) {
+	int kbinput = do_key_prompt(msg, false);
+
+	if (kbinput < 0) {
+		return '\0';
+	} else if (kbinput == TAB_CODE) {
+		return '\t';
 	} else if ((' ' <= kbinput) && (kbinput <= '~')) {
-		response = kbinput;
+		return kbinput;
 	} else {
-		response = '\1';
+		return '\1';
 	}
-	
-	free(message);
+}
+
+static char read_head_char(char *head) {
+	bool generators = (jump_menu != MBROWSER);
+	int kbinput = do_key_prompt(_("Head char: "), generators);
+	int length = 1;
+
+	if (kbinput < 0) { return '\0'; }
+
+	target = TARGET_CHAR;
+	if (generators) switch (kbinput) {
+		case 0x0C: target = TARGET_LINE; break;    // ^L
+		case 0x02: target = TARGET_BRACKET; break; // ^B
+		case 0x17: target = TARGET_WORD; break;    // ^W
+		case 0x06: target = TARGET_MATCH; break;   // ^F
+	}
+	if (target != TARGET_CHAR) {
+		head[0] = '\0';
+		return '\2';
+	}
+	if (kbinput < ' ' || kbinput == 0x7F || kbinput > 0xFF) { return '\1'; }
+
+	head[0] = (kbinput < 0x80) ? tolower(kbinput) : kbinput;
+
+#ifdef ENABLE_UTF8
+	if (kbinput >= 0x80 && using_utf8()) {
+		// the other bytes of the character arrive as keystrokes of their own
+		length = (kbinput >= 0xF0) ? 4 : (kbinput >= 0xE0) ? 3 : 2;
+		if (length > MAXCHARLEN) { length = MAXCHARLEN; }
+		for (int i = 1; i < length; i++) {
+			head[i] = get_kbinput(bottomwin);
+		}
+		head[length] = '\0';
+		if (mblen(head, length) != length || is_cntrl_mbchar(head)) {
+			IGNORE_CALL_RESULT(mblen(NULL, 0));
+			return '\1';
+		}
+	}
+#endif
+	head[length] = '\0';
 
-	return response;
+	return head[0];
 }
 
-void emplace(node_t *node, node_t **head_ptr, node_t **tail_ptr) {
-	node_t *head = *head_ptr;
-	node_t *tail = *tail_ptr;
-	if (head == NULL) {
-		head = malloc(sizeof(node_t));
-		*head_ptr = head;
-		*tail_ptr = head;
-		tail = head;
-	} else {
-		tail->next = malloc(sizeof(node_t));
-		tail = tail->next;
-		*tail_ptr = tail;
-	}
-	*tail = *node;
-	tail->next = NULL;
-}
-
-int do_highlight_char(WINDOW *win, char c, node_t **heads, node_t **tails) {
-	int p = 0, num_highlighted = 0;
-
-	// highlight initial
-	int y = 0, x = 0;
-	int max_y = 0, max_x = 0;
-	getmaxyx(win, max_y, max_x);
-	filestruct *line_ptr = openfile->edittop;
-	int line = openfile->edittop->lineno;
-	int col = openfile->firstcolumn;
-	char *at = &line_ptr->data[col];
-	
-	bool next_starts_word = true;
-	char prev_char = '\0';
-	
-	while ((y <= max_y) && (x <= max_x) && (line_ptr != NULL)) {
-		if (*at == '\0') { // reached the end of the line data
-			line++; col = 0;
-			y++; x = 0;
-			if (line_ptr->next == NULL) { break; }
-			if (line_ptr->next->lineno != line_ptr->lineno) {
-				prev_char = '\0';
-				next_starts_word = true;
-			}
-			line_ptr = line_ptr->next;
-			at = &line_ptr->data[col];
+static void table_reserve(size_t needed) {
+	if (needed <= table.capacity) { return; }
+
+	size_t capacity = (table.capacity == 0) ? 256 : table.capacity;
+	while (capacity < needed) { capacity *= 2; }
+
+	table.y = nrealloc(table.y, capacity * sizeof(int));
+	table.x = nrealloc(table.x, capacity * sizeof(int));
+	table.line = nrealloc(table.line, capacity * sizeof(int));
+	table.col = nrealloc(table.col, capacity * sizeof(int));
+	table.lines = nrealloc(table.lines, capacity * sizeof(filestruct *));
+	table.files = nrealloc(table.files, capacity * sizeof(openfilestruct *));
+	table.index = nrealloc(table.index, capacity * sizeof(size_t));
+	table.label = nrealloc(table.label, capacity * sizeof(size_t));
+	table.length = nrealloc(table.length, capacity * sizeof(int));
+	table.order = nrealloc(table.order, capacity * sizeof(size_t));
+	table.capacity = capacity;
+#ifdef DEBUG
+	jump_stats.growths++;
+#endif
+}
+
+#ifdef DEBUG
+static void report_jump(void) {
+	if (jump_stats.scanned == 0) {
+		fprintf(stderr, "jump-mode: cancelled before scanning\n");
+		return;
+	}
+
+	fprintf(stderr, "jump-mode: %lu candidates (%lu on screen, %d labelled), "
+			"needle %lu, %d label rounds, %lu table growths, "
+			"%.3f ms scanning, %.3f ms in all\n",
+			(unsigned long)table.count, (unsigned long)table.onscreen,
+			jump_stats.labelled, (target == TARGET_CHAR) ? (unsigned long)tail_length + 1 : 0,
+			jump_stats.rounds, (unsigned long)jump_stats.growths,
+			(double)(jump_stats.scanned - jump_stats.start) * 1000 / CLOCKS_PER_SEC,
+			(double)(clock() - jump_stats.start) * 1000 / CLOCKS_PER_SEC);
+}
+#endif
+
+static void table_add(int y, int x, filestruct *line_ptr, size_t index, int col) {
+	size_t i = table.count;
+
+	table_reserve(i + 1);
+	table.y[i] = y;
+	table.x[i] = x;
+	// a line of another buffer is numbered by the shifts of that buffer
+	table.line[i] = (line_ptr != NULL) ? line_number_in(scanned_file, line_ptr) : 0;
+	table.col[i] = col;
+	table.lines[i] = line_ptr;
+	table.files[i] = scanned_file;
+	table.index[i] = index;
+	table.label[i] = 0;
+	table.length[i] = 0;
+	table.count++;
+}
+
+static bool table_keeps(size_t i, size_t pos, char c) {
+	const char *data = table.lines[i]->data + table.index[i];
+
+	// the head may be a multibyte character, so step over it whole; after
+	// it, the needle is compared byte by byte (folding only ASCII letters),
+	// and the bytes before the `pos`th one have been matched already
+	data += parse_mbchar(data, NULL, NULL);
+
+	// the needle must not run past the end of the line
+	return (strnlen(data, pos) >= pos && tolower((unsigned char)data[pos - 1]) == c);
+}
+
+static void table_move(size_t to, size_t from) {
+	table.y[to] = table.y[from];
+	table.x[to] = table.x[from];
+	table.line[to] = table.line[from];
+	table.col[to] = table.col[from];
+	table.lines[to] = table.lines[from];
+	table.files[to] = table.files[from];
+	table.index[to] = table.index[from];
+}
+
+static size_t table_filter(size_t pos, char c) {
+	size_t kept = 0, onscreen = 0;
+
+	for (size_t i = 0; i < table.count; i++) {
+		if (!table_keeps(i, pos, c)) { continue; }
+		if (i < table.onscreen) { onscreen++; }
+		table_move(kept++, i);
+	}
+
+	if (pos <= sizeof(needle_tail)) {
+		needle_tail[pos - 1] = c;
+		tail_length = pos;
+	}
+
+	table.onscreen = onscreen;
+	table.count = kept;
+	return kept;
+}
+
+#ifdef ENABLE_MULTIBUFFER
+static void table_sift(size_t from) {
+	size_t kept = from;
+
+	for (size_t i = from; i < table.count; i++) {
+		size_t pos = 1;
+		while (pos <= tail_length && table_keeps(i, pos, needle_tail[pos - 1])) { pos++; }
+		if (pos > tail_length) { table_move(kept++, i); }
+	}
+
+	table.count = kept;
+}
+#endif
+
+static bool read_needle(const char *head) {
+	char needle[MAXCHARLEN + 3];
+	size_t head_len = strlen(head);
+
+	strcpy(needle, head);
+
+	for (int len = 1; len < jump_mode_needle && table.count > 1; len++) {
+		char *msg = charalloc(strlen(_("Needle: ")) + head_len + len + 1);
+
+		sprintf(msg, "%s%s", _("Needle: "), needle);
+		char next_char = do_char_prompt(msg);
+		free(msg);
+
+		if (next_char == '\0') { return false; }
+		if (next_char == '\1') { break; } // Enter: this much is enough
+
+		needle[head_len + len - 1] = tolower(next_char);
+		needle[head_len + len] = '\0';
+		table_filter(len, tolower(next_char));
+		collect_until(2);
+	}
+
+	return true;
+}
+
+static bool type_ahead(WINDOW *win, const char *head) {
+	attr_t attr = use_color ? color_highlight_attr : nocolor_highlight_attr;
+	char needle[MAXCHARLEN + sizeof(needle_tail) + 1];
+	size_t head_len = strlen(head);
+	char next_char = '\1';
+	size_t len = 1;
+
+	strcpy(needle, head);
+
+	for (size_t i = 0; i < table.onscreen; i++) {
+		overlay_save(win, table.y[i], table.x[i]);
+	}
+	for (size_t i = 0; i < table.onscreen; i++) {
+		overlay_paint(win, table.y[i], table.x[i], '\0', attr);
+	}
+	wnoutrefresh(win);
+
+	while (table.count > 1) {
+		char *msg = charalloc(strlen(_("Type-ahead (Enter: labels): ")) + head_len + len);
+
+		sprintf(msg, "%s%s", _("Type-ahead (Enter: labels): "), needle);
+		next_char = do_char_prompt(msg);
+		free(msg);
+
+		if (next_char == '\0' || next_char == '\1' || next_char == '\t') { break; }
+		next_char = tolower(next_char);
+
+		// the needle can grow only as far as the tail of it is remembered
+		// (for sifting the buffers that are scanned later)
+		if (len > sizeof(needle_tail)) {
+			beep();
 			continue;
-		} else {
-			if (tolower(*at) == c) {
-				if (ISSET(JUMP_INSIDE) || (next_starts_word && (prev_char != tolower(*at)))) {
-					wattron(win, use_color ? color_highlight_attr : nocolor_highlight_attr);
-					mvwaddch(win, y, x, jump_mode_label_chars[p]);
-
-					node_t new = (node_t){y, x, line, col, *at, NULL};
-					emplace(&new, &heads[p], &tails[p]);
-				
-					p++;
-					if (jump_mode_label_chars[p] == '\0') { p = 0; }
-					num_highlighted++;
-				
-					wattroff(win, use_color ? color_highlight_attr : nocolor_highlight_attr);
+		}
+
+		// only the marks of the candidates that drop out are repainted,
+		// and a character that would leave nothing is simply refused
+		size_t left = 0;
+		for (size_t i = 0; i < table.count; i++) {
+			if (table_keeps(i, len, next_char)) { left++; }
+		}
+		if (left == 0) {
+			beep();
+			continue;
+		}
+		for (size_t i = 0; i < table.onscreen; i++) {
+			if (!table_keeps(i, len, next_char)) {
+				overlay_restore(win, table.y[i], table.x[i]);
+			}
+		}
+		wnoutrefresh(win);
+
+		table_filter(len, next_char);
+		collect_until(2);
+		needle[head_len + len - 1] = next_char;
+		needle[head_len + len] = '\0';
+		len++;
+	}
+
+	overlay_clear(win);
+	wnoutrefresh(win);
+
+	return (next_char != '\0');
+}
+
+static int step_char(const char *at, size_t *col) {
+	if ((unsigned char)*at >= ' ' && (unsigned char)*at < 0x7F) {
+		(*col)++;
+		return 1;
+	}
+	return parse_mbchar(at, NULL, col);
+}
+
+static bool is_head(const char *at, const char *head) {
+	if (head[1] == '\0') { // an ASCII head needs no decoding of the text
+		return (tolower((unsigned char)*at) == head[0]);
+	}
+	return ((unsigned char)*at >= 0x80 && mbstrncasecmp(at, head, 1) == 0);
+}
+
+static bool is_alnum_at(const char *at) {
+	return ((unsigned char)*at < 0x80) ? isalnum((unsigned char)*at) : is_alnum_mbchar(at);
+}
+
+static void scan_line(filestruct *line_ptr, const char *head, size_t start, size_t end,
+                      int y, size_t leftedge) {
+	const char *data = line_ptr->data;
+	const char *next_match = NULL;
+	bool starts_word = true, starts_ident = true, prev_matched = false;
+	size_t col = 0, first_col = leftedge, last_col = leftedge + editwincols;
+
+	// a line start is a target only where the line itself starts
+	if (target == TARGET_LINE) {
+		if (start == 0 && leftedge == 0) {
+			table_add(y, (y < 0) ? -1 : margin, line_ptr, 0, 0);
+		}
+		return;
+	}
+
+	// pick up the word state from the character before the row
+	if (start > 0) {
+		size_t before = move_mbleft(data, start);
+		starts_word = !is_alnum_at(data + before);
+		starts_ident = starts_word && data[before] != '_';
+		prev_matched = (target == TARGET_CHAR && is_head(data + before, head));
+		col = strnlenpt(data, start);
+	}
+
+	// without softwrap, a "$" covers the first and last cell of a row that
+	// shows only part of its line
+	if (y >= 0 && !ISSET(SOFTWRAP)) {
+		if (leftedge > 0) { first_col++; }
+		if (data[end] != '\0') { last_col--; }
+	}
+
+	if (target == TARGET_MATCH) {
+		next_match = strstrwrapper(data, last_search, data + start);
+	}
+
+	for (size_t index = start; index < end && data[index] != '\0'; ) {
+		const char *at = data + index;
+		size_t next_col = col;
+		int length = step_char(at, &next_col);
+		bool alnum = is_alnum_at(at), matches = false, hit = false;
+
+		switch (target) {
+			case TARGET_CHAR:
+				matches = is_head(at, head);
+				hit = matches && (ISSET(JUMP_INSIDE) || (starts_word && !prev_matched));
+				break;
+			case TARGET_WORD:
+				// a number is not an identifier, but may be part of one
+				hit = starts_ident && alnum && !isdigit((unsigned char)*at);
+				hit = hit || (starts_ident && *at == '_');
+				break;
+#ifndef NANO_TINY
+			case TARGET_BRACKET:
+				hit = ((unsigned char)*at < 0x80) ? (strchr(matchbrackets, *at) != NULL) :
+				                                   (mbstrchr(matchbrackets, at) != NULL);
+				break;
+#endif
+			case TARGET_MATCH:
+				// look for the next match only once the previous one is passed
+				if (next_match != NULL && next_match < at) {
+					next_match = strstrwrapper(data, last_search, at);
 				}
+				hit = (at == next_match);
+				break;
+			default:
+				break;
+		}
+
+		if (hit) {
+			if (y < 0) {
+				table_add(-1, -1, line_ptr, index, col);
+			} else if (col >= first_col && next_col <= last_col) {
+				table_add(y, margin + col - leftedge, line_ptr, index, col);
 			}
 		}
+		prev_matched = matches;
+		starts_word = !alnum;
+		starts_ident = !alnum && *at != '_';
+
+		index += length;
+		col = next_col;
+	}
+}
+
+static void collect_line(filestruct *line_ptr, const char *head) {
+#ifndef NANO_TINY
+	if (!line_may_contain(line_ptr, CHARMAP_BIT(head[0]), !ISSET(JUMP_INSIDE))) { return; }
+#endif
+
+	scan_line(line_ptr, head, 0, (size_t)-1, -1, 0);
+}
+
+static void collect_offscreen(const char *head) {
+	filestruct *bottom = openfile->edittop;
+
+	// the screen map knows which line is drawn last
+	for (int y = 0; y < editwinrows; y++) {
+		const screenrow *row = mapped_row(y);
+		if (row != NULL) { bottom = row->line; }
+	}
+
+	filestruct *above = openfile->edittop->prev;
+	filestruct *below = bottom->next;
+
+	for (ssize_t distance = 0; above != NULL || below != NULL; distance++) {
+		if (jump_mode_radius > 0 && distance >= jump_mode_radius) { break; }
+		if (table.count - table.onscreen >= max_offscreen) { break; }
+
+		if (below != NULL) {
+			collect_line(below, head);
+			below = below->next;
+		}
+		if (above != NULL) {
+			collect_line(above, head);
+			above = above->prev;
+		}
+	}
+
+	if (table.count - table.onscreen > max_offscreen) {
+		table.count = table.onscreen + max_offscreen;
+	}
+}
 
-		prev_char = tolower(*at);
-		next_starts_word = !is_alnum_mbchar(at);
-		size_t charwidth = 0;
-		parse_mbchar(at, NULL, &charwidth);
-		col += charwidth;
-		x += charwidth;
-		at++;
-		if (x >= editwincols) {
-			y++; x = 0;
-			if (!ISSET(SOFTWRAP) && (*at != '\0')) { // reached the end of the screen but there's more
-				prev_char = '\0';
-				next_starts_word = true;
-				line_ptr = line_ptr->next;
-				if (line_ptr == NULL) { break; }
-				line++; col = 0;
-				at = &line_ptr->data[col];
+static ssize_t select_offscreen(void) {
+	size_t num_labels = strlen(jump_mode_label_chars);
+	size_t first = table.onscreen;
+	char *msg = charalloc(COLS + 1);
+
+	while (true) {
+		// fill the status bar with as many "label:line" entries as fit,
+		// naming the buffer for those that are not in this one
+		size_t shown = 0, len = 0;
+		char entry[32];
+
+		collect_until(first + num_labels);
+
+		snprintf(msg, COLS + 1, "%s", _("Off-screen (Tab: more):"));
+		len = strlen(msg);
+		while (first + shown < table.count && shown < num_labels) {
+			size_t i = first + shown;
+			int n;
+
+			if (table.files[i] == openfile) {
+				n = snprintf(entry, sizeof(entry), " %c:%d",
+				             jump_mode_label_chars[shown], table.line[i]);
+			} else {
+				const char *name = table.files[i]->filename;
+				n = snprintf(entry, sizeof(entry), " %c:%.12s:%d", jump_mode_label_chars[shown],
+				             (name[0] == '\0') ? _("New Buffer") : tail(name), table.line[i]);
 			}
+			if (len + n > COLS - 1) {
+				// on a very narrow terminal, show at least the first entry
+				// (in place of the heading, and cut short if need be), so
+				// that it can still be picked and Tab still moves on
+				if (shown == 0) {
+					snprintf(msg, COLS, "%s", entry + 1);
+					shown++;
+				}
+				break;
+			}
+			strcpy(msg + len, entry);
+			len += n;
+			shown++;
+		}
+
+		char select_char = do_char_prompt(msg);
+		blank_statusbar();
+
+		if (select_char == '\0') { break; }
+
+		if (select_char == '\t') { // next page, wrapping around
+			first += shown;
+			collect_until(first + 1);
+			if (first >= table.count) { first = table.onscreen; }
+			continue;
+		}
+
+		char *picked = strchr(jump_mode_label_chars, select_char);
+		if (picked != NULL && (picked - jump_mode_label_chars) < shown) {
+			free(msg);
+			return first + (picked - jump_mode_label_chars);
+		}
+
+		statusbar(_("jump-mode: No such position candidate"));
+		free(msg);
+		return -1;
+	}
+
+	free(msg);
+	return -1;
+}
+
+static bool collect_next_file(void) {
+#ifdef ENABLE_MULTIBUFFER
+	if (next_file == NULL) { return false; }
+
+	size_t from = table.count;
+	filestruct *line_ptr = next_file->edittop;
+	int rows = ISSET(SOFTWRAP) ? -(int)(next_file->firstcolumn / editwincols) : 0;
+
+	scanned_file = next_file;
+	while (line_ptr != NULL && rows < editwinrows && table.count - table.onscreen < max_offscreen) {
+		collect_line(line_ptr, scanned_head);
+		rows += ISSET(SOFTWRAP) ? line_width(line_ptr) / editwincols + 1 : 1;
+		line_ptr = line_ptr->next;
+	}
+	scanned_file = openfile;
+	table_sift(from);
+
+	next_file = (next_file->next == openfile) ? NULL : next_file->next;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void collect_until(size_t wanted) {
+	while (table.count < wanted && collect_next_file()) {}
+}
+
+static void collect_candidates(WINDOW *win, const char *head) {
+	int max_y = getmaxy(win);
+
+	scanned_file = openfile;
+	strcpy(scanned_head, head);
+	tail_length = 0;
+#ifdef ENABLE_MULTIBUFFER
+	// a selection cannot reach into another buffer
+	next_file = (ISSET(JUMP_ALLBUFFERS) && !selecting && jump_menu == MMAIN &&
+	             openfile->next != openfile) ? openfile->next : NULL;
+#endif
+
+	// scan just what the screen map says was drawn on each row
+	for (int y = 0; y < max_y; y++) {
+		const screenrow *row = mapped_row(y);
+
+		if (row == NULL) { continue; }
+#ifndef NANO_TINY
+		if (target == TARGET_CHAR &&
+				!line_may_contain(row->line, CHARMAP_BIT(head[0]), !ISSET(JUMP_INSIDE))) { continue; }
+#endif
+		scan_line(row->line, head, row->start, row->end, y, row->leftedge);
+	}
+
+	table.onscreen = table.count;
+
+	// the generated targets are those in the viewport only
+	if (target != TARGET_CHAR) {
+		next_file = NULL;
+		return;
+	}
+
+	if (ISSET(JUMP_BUFFER) && jump_menu == MMAIN) {
+		collect_offscreen(head);
+	}
+}
+
+#ifdef ENABLE_BROWSER
+static void collect_shown_names(const char *head) {
+	const char *name;
+	int y, x;
+
+	scanned_file = openfile;
+	next_file = NULL;
+	tail_length = 0;
+
+	for (size_t n = 0; (name = browser_shown_name(n, &y, &x)) != NULL; n++) {
+		if (is_head(name, head)) {
+			table_add(y, x, NULL, n, 0);
 		}
 	}
 
-	wrefresh(win);
+	table.onscreen = table.count;
+}
+#endif
+
+int do_highlight_char(WINDOW *win, const char *head) {
+	collect_candidates(win, head);
 
-	return num_highlighted;
+	return do_highlight_these(win);
 }
 
-int do_highlight_these(WINDOW *win, node_t *these, node_t **heads, node_t **tails) {
-	int p = 0, num_highlighted = 0;
+static long distance_to_cursor(size_t i) {
+	long dy = table.y[i] - cursor_y, dx = table.x[i] - cursor_x;
 
-	// highlight initial
-	wmove(win, 0, 0);
+	// a row is about twice as tall as a column is wide
+	return 4 * dy * dy + dx * dx;
+}
+
+static int closer_to_cursor(const void *a, const void *b) {
+	size_t i = *(const size_t *)a, j = *(const size_t *)b;
+	long di = distance_to_cursor(i), dj = distance_to_cursor(j);
+
+	if (di != dj) { return (di < dj) ? -1 : 1; }
+	return (i < j) ? -1 : (i > j); // keep screen order among equals
+}
+
+static int assign_labels(void) {
+	size_t k = strlen(jump_mode_label_chars), n = table.onscreen;
+	size_t span = 1; // k^(depth - 1): how many labels are one shorter
+	int depth = 1;
+
+	getyx(edit, cursor_y, cursor_x);
 
-	while (these != NULL) {
-		wattron(win, use_color ? color_highlight_attr : nocolor_highlight_attr);
-		mvwaddch(win, these->y, these->x, jump_mode_label_chars[p]);
+	// with nothing on screen, the order array may not even exist yet
+	if (n == 0) { return depth; }
 
-		emplace(these, &heads[p], &tails[p]);
-		
-		p++;
-		if (jump_mode_label_chars[p] == '\0') { p = 0; }
-		num_highlighted++;
+	for (size_t i = 0; i < n; i++) { table.order[i] = i; }
+	qsort(table.order, n, sizeof(size_t), closer_to_cursor);
 
-		these = these->next;
-		
-		wattroff(win, use_color ? color_highlight_attr : nocolor_highlight_attr);
+	while (span * k < n) {
+		span *= k;
+		depth++;
+	}
+
+	// A complete k-ary tree: of the `span` nodes one level above the
+	// leaves, the last `expanded` get k children each, just enough to
+	// hold all n targets; the rest stay leaves, and so shorter labels,
+	// which go to the targets nearest to the cursor.
+	size_t expanded = (depth == 1) ? 0 : (n - span + k - 2) / (k - 1);
+	size_t shorter = (depth == 1) ? 0 : span - expanded;
+
+	for (size_t rank = 0; rank < n; rank++) {
+		size_t i = table.order[rank];
+
+		if (rank < shorter) {
+			table.label[i] = rank;
+			table.length[i] = depth - 1;
+		} else {
+			size_t j = rank - shorter;
+			table.label[i] = (depth == 1) ? j : (shorter + j / k) * k + j % k;
+			table.length[i] = depth;
+		}
 	}
 
-	wrefresh(win);
+	return depth;
+}
+
+static char label_char(size_t i, int pos) {
+	size_t k = strlen(jump_mode_label_chars), label = table.label[i];
 
-	return num_highlighted;
+	for (int p = table.length[i] - 1; p > pos; p--) { label /= k; }
+	return jump_mode_label_chars[label % k];
 }
 
-void cleanup_highlight(WINDOW *win, node_t **heads, node_t **tails) {
-	for (int i = 0; i < strlen(jump_mode_label_chars); i++) {
-		node_t *cur = heads[i];
-		while (cur != NULL) {
-			node_t *trash = cur;
+static void draw_label(WINDOW *win, size_t i) {
+	attr_t attr = use_color ? color_highlight_attr : nocolor_highlight_attr;
+
+	for (int p = 0; p < table.length[i] && table.x[i] + p < COLS; p++) {
+		overlay_paint(win, table.y[i], table.x[i] + p, label_char(i, p), attr);
+	}
+}
 
-			// restore old character
-			wattroff(win, use_color ? color_highlight_attr : nocolor_highlight_attr);
-			mvwaddch(win, cur->y, cur->x, cur->c);
-			
-			cur = cur->next;
-			free(trash);
+static void erase_label(WINDOW *win, size_t i) {
+	for (int p = 0; p < table.length[i] && table.x[i] + p < COLS; p++) {
+		overlay_restore(win, table.y[i], table.x[i] + p);
+	}
+}
+
+static size_t rule_out(WINDOW *win, int pos, char key) {
+	size_t left = 0;
+
+	for (size_t i = 0; i < table.onscreen; i++) {
+		if (table.length[i] == 0) { continue; }
+		if (pos < table.length[i] && label_char(i, pos) == key) {
+			left++;
+		} else {
+			erase_label(win, i);
+			table.length[i] = 0;
 		}
 	}
-	wrefresh(win);
 
-	for (int i = 0; i < strlen(jump_mode_label_chars); i++) {
-		heads[i] = NULL; tails[i] = NULL;
+	// an erased label may have run into one that is still standing
+	for (size_t i = 0; i < table.onscreen; i++) {
+		if (table.length[i] > 0) { draw_label(win, i); }
 	}
+	wnoutrefresh(win);
+
+	return left;
+}
+
+int do_highlight_these(WINDOW *win) {
+	label_depth = assign_labels();
+
+	// save everything first, since a label can run into the next target
+	for (size_t i = 0; i < table.onscreen; i++) {
+		for (int p = 0; p < table.length[i] && table.x[i] + p < COLS; p++) {
+			overlay_save(win, table.y[i], table.x[i] + p);
+		}
+	}
+	for (size_t i = 0; i < table.onscreen; i++) {
+		draw_label(win, i);
+	}
+	wnoutrefresh(win);
+
+	return (int)table.onscreen;
+}
+
+void cleanup_highlight(WINDOW *win) {
+	overlay_clear(win);
+	wnoutrefresh(win);
 }
 
-void move_cursor(ssize_t line, ssize_t column)
-{ // copied from search.c, remove the code to recenter the screen
-	if (line == 0) line = openfile->current->lineno;
-	if (column == 0) column = openfile->placewewant + 1;
+#ifdef OVERLAY_WIDE
+// whether the cell holds a double-width character
+static bool cell_is_wide(WINDOW *win, int y, int x, cchar_t *cell) {
+	wchar_t wch[CCHARW_MAX + 1];
+	attr_t attrs;
+	short pair;
 
-	if (line < 0) line = openfile->filebot->lineno + line + 1;
-	if (line < 1) line = 1;
+	mvwin_wch(win, y, x, cell);
+	getcchar(cell, wch, &attrs, &pair, NULL);
+	return (wcwidth(wch[0]) == 2);
+}
+#endif
 
-	/* Iterate to the requested line. */
-	for (openfile->current = openfile->fileage;
-	     line > 1 && openfile->current != openfile->filebot;
-	     line--) {
-		openfile->current = openfile->current->next;
+static void overlay_save(WINDOW *win, int y, int x) {
+	int rows, cols;
+	getmaxyx(win, rows, cols);
+
+	if (rows != overlay_rows || cols != overlay_cols) {
+		overlay_rows = rows;
+		overlay_cols = cols;
+		overlay_at = nrealloc(overlay_at, rows * cols * sizeof(size_t));
+		memset(overlay_at, 0, rows * cols * sizeof(size_t));
+		overlay_count = 0;
+	}
+
+	if (overlay_at[y * cols + x] != 0) { return; }
+
+	if (overlay_count == overlay_capacity) {
+		overlay_capacity = (overlay_capacity == 0) ? 256 : overlay_capacity * 2;
+		covered = nrealloc(covered, overlay_capacity * sizeof(covered_cell));
 	}
 
-	/* Take a negative column number to mean: from the end of the line. */
-	if (column < 0) column = strlenpt(openfile->current->data) + column + 2;
-	if (column < 1) column = 1;
+	covered_cell *saved = &covered[overlay_count];
+	int width = 1;
+
+	saved->y = y;
+	saved->x = x;
+#ifdef OVERLAY_WIDE
+	// curses reports both halves of a double-width character alike, but
+	// as nothing is painted yet, a run of them always starts with a head
+	if (cell_is_wide(win, y, x, &saved->cell)) {
+		cchar_t other;
+		int start = x;
 
-	/* Set the x position that corresponds to the requested column. */
-	openfile->current_x = actual_x(openfile->current->data, column - 1);
-	openfile->placewewant = column - 1;
+		while (start > 0 && cell_is_wide(win, y, start - 1, &other) &&
+				memcmp(&other, &saved->cell, sizeof(cchar_t)) == 0) {
+			start--;
+		}
+		saved->x = x - (x - start) % 2;
+		width = 2;
+	}
+#else
+	saved->cell = mvwinch(win, y, x);
+#endif
+
+	overlay_count++;
+	for (int col = saved->x; col < saved->x + width && col < cols; col++) {
+		overlay_at[y * cols + col] = overlay_count;
+	}
+}
+
+static void overlay_paint(WINDOW *win, int y, int x, char c, attr_t attr) {
+	if (c == '\0') {
+		mvwchgat(win, y, x, 1, attr & ~A_COLOR, PAIR_NUMBER(attr), NULL);
+	} else {
+		mvwaddch(win, y, x, (unsigned char)c | attr);
+	}
+}
+
+static void overlay_restore(WINDOW *win, int y, int x) {
+	size_t at = overlay_at[y * overlay_cols + x];
+
+	if (at == 0) { return; }
+
+	covered_cell *saved = &covered[at - 1];
+#ifdef OVERLAY_WIDE
+	mvwadd_wch(win, saved->y, saved->x, &saved->cell);
+#else
+	mvwaddch(win, saved->y, saved->x, saved->cell);
+#endif
+}
+
+static void overlay_clear(WINDOW *win) {
+	for (size_t i = 0; i < overlay_count; i++) {
+		covered_cell *saved = &covered[i];
+
+#ifdef OVERLAY_WIDE
+		mvwadd_wch(win, saved->y, saved->x, &saved->cell);
+#else
+		mvwaddch(win, saved->y, saved->x, saved->cell);
+#endif
+		overlay_at[saved->y * overlay_cols + saved->x] = 0;
+		if (saved->x + 1 < overlay_cols) {
+			overlay_at[saved->y * overlay_cols + saved->x + 1] = 0;
+		}
+	}
+	overlay_count = 0;
+}
+
+void jump_to_candidate(size_t index) {
+#ifdef ENABLE_MULTIBUFFER
+	if (table.files[index] != openfile) {
+		openfile = table.files[index];
+		redecorate_after_switch();
+		openfile->current = table.lines[index];
+		openfile->current_x = table.index[index];
+		openfile->placewewant = xplustabs();
+		return;
+	}
+#endif
+	openfile->current = table.lines[index];
+	openfile->current_x = table.index[index];
 
-	if (ISSET(SOFTWRAP) && openfile->placewewant / editwincols >
-	    strlenpt(openfile->current->data) / editwincols) {
-		openfile->placewewant = strlenpt(openfile->current->data);
+	// placewewant is left to edit_redraw(), which needs the old value to
+	// see whether the line being left was scrolled sideways
+	if (index >= table.onscreen) {
+		// off-screen: let edit_redraw() center the line
+		focusing = TRUE;
+	} else if (ISSET(JUMP_CENTER) && jump_menu == MMAIN && !selecting) {
+		openfile->placewewant = xplustabs();
+		center_the_target();
 	}
 }
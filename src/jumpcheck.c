@@ -0,0 +1,370 @@
+/**************************************************************************
+ *   jumpcheck.c  --  This file is part of GNU nano.                      *
+ *                                                                        *
+ *   Copyright (C) 2017 Free Software Foundation, Inc.                    *
+ *                                                                        *
+ *   GNU nano is free software: you can redistribute it and/or modify     *
+ *   it under the terms of the GNU General Public License as published    *
+ *   by the Free Software Foundation, either version 3 of the License,    *
+ *   or (at your option) any later version.                               *
+ *                                                                        *
+ *   GNU nano is distributed in the hope that it will be useful,          *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/* A headless driver for jump-mode: it runs nano on a pseudo-terminal,
+ * types a scripted jump, marks where the cursor landed by typing an X,
+ * saves, and compares the file with what it should have become.  It
+ * reports the wall time of each jump, and when nano was built with
+ * --enable-debug, also the cost line that nano prints for each jump.
+ *
+ * Usage: jumpcheck [nano [rows columns]]
+ * Exits with 0 when all checks pass, 1 when one fails, and 77 (skip)
+ * when nano cannot be run on a pseudo-terminal here. */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SKIP 77
+
+#define SETTLE_MS 150
+	/* How long nano must stay quiet before it counts as waiting for
+	 * the next key. */
+#define START_MS 10000
+	/* How long nano may take to draw its first screen. */
+
+typedef struct jumpcase {
+    const char *name;
+	/* What the case checks. */
+    const char *text;
+	/* The file that nano gets to edit. */
+    const char *keys;
+	/* What gets typed after ^G, up to and including the label. */
+    const char *expected;
+	/* The file after an X was typed where the jump landed. */
+} jumpcase;
+
+static const jumpcase cases[] = {
+    {"only candidate",
+	"one\ntwo\nthe q is here\nfour\n", "q",
+	"one\ntwo\nthe Xq is here\nfour\n"},
+    {"head folds case",
+	"one\ntwo\nthree\nQuit\n", "q",
+	"one\ntwo\nthree\nXQuit\n"},
+    {"nearest gets first label",
+	"one\ntwo z\nthree\nfour\nfive\nz six\n", "za",
+	"one\ntwo Xz\nthree\nfour\nfive\nz six\n"},
+    {"farther gets next label",
+	"one\ntwo z\nthree\nfour\nfive\nz six\n", "zb",
+	"one\ntwo z\nthree\nfour\nfive\nXz six\n"},
+    {"third label",
+	"one\ntwo z\nthree\nfour\nfive\nz six\n7\n8\n9\nz ten\n", "zc",
+	"one\ntwo z\nthree\nfour\nfive\nz six\n7\n8\n9\nXz ten\n"},
+    {"unknown label stays put",
+	"one\ntwo z\nthree z\n", "z!",
+	"Xone\ntwo z\nthree z\n"},
+    {"absent head stays put",
+	"one\ntwo\n", "k",
+	"Xone\ntwo\n"},
+    {"cancel stays put",
+	"one\ntwo q\n", "\x03",
+	"Xone\ntwo q\n"},
+};
+
+static int master = -1;
+	/* Our end of the pseudo-terminal. */
+static const char *no_rcfiles = NULL;
+	/* The option that keeps nano from reading any nanorc, when nano
+	 * was built with nanorc support. */
+
+/* Return the number of milliseconds since some fixed moment. */
+static double now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* Read and discard what nano draws, until it has been quiet for SETTLE_MS
+ * or patience runs out.  Return when the last output arrived, or a
+ * negative number when nothing came at all. */
+static double settle(int patience)
+{
+    struct pollfd pfd = {master, POLLIN, 0};
+    double start = now_ms(), last = -1;
+    char junk[4096];
+
+    while (now_ms() - start < patience) {
+	if (poll(&pfd, 1, SETTLE_MS) <= 0) {
+	    if (last >= 0)
+		break;
+	    continue;
+	}
+	if (read(master, junk, sizeof(junk)) <= 0)
+	    break;
+	last = now_ms();
+    }
+
+    return last;
+}
+
+/* Type the given keys, one at a time, letting nano react to each.
+ * Return how many milliseconds nano took in all to finish drawing its
+ * response to the keys. */
+static double type(const char *keys)
+{
+    double took = 0, sent, last;
+
+    for (; *keys != '\0'; keys++) {
+	sent = now_ms();
+	if (write(master, keys, 1) != 1)
+	    break;
+	last = settle(SETTLE_MS * 4);
+	if (last > sent)
+	    took += last - sent;
+    }
+
+    return took;
+}
+
+/* Start nano on the given file, on a pseudo-terminal of the given size.
+ * Return its pid, or -1 when that is not possible here. */
+static pid_t start_nano(const char *nano, const char *file,
+	const char *errfile, int rows, int cols)
+{
+    struct winsize size = {rows, cols, 0, 0};
+    char *slavename;
+    pid_t pid;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 ||
+		(slavename = ptsname(master)) == NULL)
+	return -1;
+
+    ioctl(master, TIOCSWINSZ, &size);
+
+    pid = fork();
+    if (pid < 0)
+	return -1;
+
+    if (pid == 0) {
+	int slave, err;
+
+	setsid();
+	slave = open(slavename, O_RDWR);
+	err = open(errfile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (slave < 0 || err < 0)
+	    _exit(SKIP);
+#ifdef TIOCSCTTY
+	ioctl(slave, TIOCSCTTY, 0);
+#endif
+	ioctl(slave, TIOCSWINSZ, &size);
+	dup2(slave, 0);
+	dup2(slave, 1);
+	dup2(err, 2);
+	close(master);
+
+	setenv("TERM", "vt100", 1);
+	if (no_rcfiles != NULL)
+	    execl(nano, nano, no_rcfiles, file, (char *)NULL);
+	else
+	    execl(nano, nano, file, (char *)NULL);
+	_exit(SKIP);
+    }
+
+    return pid;
+}
+
+/* Return TRUE when nano accepts the given option. */
+static int knows_option(const char *nano, const char *option)
+{
+    int status;
+    pid_t pid = fork();
+
+    if (pid == 0) {
+	int null = open("/dev/null", O_WRONLY);
+
+	dup2(null, 1);
+	dup2(null, 2);
+	execl(nano, nano, option, "--version", (char *)NULL);
+	_exit(SKIP);
+    }
+
+    return (pid > 0 && waitpid(pid, &status, 0) == pid &&
+		WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/* Stop nano, and return its exit status. */
+static int stop_nano(pid_t pid)
+{
+    int status, waited;
+
+    for (waited = 0; waited < 50; waited++) {
+	if (waitpid(pid, &status, WNOHANG) == pid) {
+	    close(master);
+	    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
+	/* Keep draining the terminal, so that nano does not block on it. */
+	settle(100);
+	poll(NULL, 0, 100);
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    close(master);
+    return -1;
+}
+
+/* Write the given text to the given file; return FALSE on failure. */
+static int put_file(const char *file, const char *text)
+{
+    FILE *f = fopen(file, "w");
+
+    if (f == NULL)
+	return 0;
+    fputs(text, f);
+    return (fclose(f) == 0);
+}
+
+/* Return the contents of the given file, or NULL. */
+static char *get_file(const char *file)
+{
+    FILE *f = fopen(file, "r");
+    char *text;
+    size_t len;
+
+    if (f == NULL)
+	return NULL;
+    text = calloc(1, 65536);
+    len = fread(text, 1, 65535, f);
+    text[len] = '\0';
+    fclose(f);
+
+    return text;
+}
+
+/* Copy the cost lines of the jump from nano's stderr to our stdout. */
+static void show_costs(const char *errfile)
+{
+    FILE *f = fopen(errfile, "r");
+    char line[512];
+
+    if (f == NULL)
+	return;
+    while (fgets(line, sizeof(line), f) != NULL)
+	if (strncmp(line, "jump-mode:", 10) == 0)
+	    printf("      %s", line);
+    fclose(f);
+}
+
+/* Run one case; return 1 when it passes, 0 when it fails, and SKIP when
+ * nano could not be run at all. */
+static int run_case(const jumpcase *c, const char *nano, const char *dir,
+	int rows, int cols)
+{
+    char file[4096], errfile[4096], *result;
+    double took;
+    pid_t pid;
+    int passed;
+
+    snprintf(file, sizeof(file), "%s/text", dir);
+    snprintf(errfile, sizeof(errfile), "%s/stderr", dir);
+
+    if (!put_file(file, c->text))
+	return SKIP;
+
+    pid = start_nano(nano, file, errfile, rows, cols);
+    if (pid < 0 || settle(START_MS) < 0) {
+	if (pid > 0)
+	    stop_nano(pid);
+	return SKIP;
+    }
+
+    /* ^G, then the head character and the label. */
+    took = type("\x07");
+    took += type(c->keys);
+
+    /* Mark the spot, save with ^O and Enter, and leave with ^X. */
+    type("X\x0f\r\x18");
+
+    if (stop_nano(pid) != 0) {
+	printf("FAIL  %s: nano did not exit cleanly\n", c->name);
+	return 0;
+    }
+
+    result = get_file(file);
+    passed = (result != NULL && strcmp(result, c->expected) == 0);
+
+    printf("%s  %s (%.1f ms)\n", passed ? "PASS" : "FAIL", c->name,
+		took);
+    if (!passed)
+	printf("      expected \"%s\"\n      got \"%s\"\n", c->expected,
+		(result != NULL) ? result : "(nothing)");
+    show_costs(errfile);
+
+    free(result);
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    const char *nano = (argc > 1) ? argv[1] : "./nano";
+    int rows = (argc > 3) ? atoi(argv[2]) : 24;
+    int cols = (argc > 3) ? atoi(argv[3]) : 80;
+    char dir[] = "/tmp/jumpcheck.XXXXXX", path[sizeof(dir) + 8];
+    int failures = 0, outcome = 0;
+    size_t i;
+
+    if (rows < 5 || cols < 30) {
+	fprintf(stderr, "jumpcheck: a screen needs at least 5 rows "
+			"and 30 columns\n");
+	return 1;
+    }
+
+    if (access(nano, X_OK) != 0 || mkdtemp(dir) == NULL)
+	return SKIP;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    /* A tiny nano reads no nanorc, and does not know the option either. */
+    if (knows_option(nano, "--ignorercfiles"))
+	no_rcfiles = "--ignorercfiles";
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+	outcome = run_case(&cases[i], nano, dir, rows, cols);
+	if (outcome == SKIP)
+	    break;
+	if (outcome == 0)
+	    failures++;
+    }
+
+    snprintf(path, sizeof(path), "%s/text", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/stderr", dir);
+    unlink(path);
+    rmdir(dir);
+
+    if (outcome == SKIP) {
+	printf("SKIP  nano cannot be run on a pseudo-terminal here\n");
+	return SKIP;
+    }
+
+    return (failures > 0) ? 1 : 0;
+}
@@ -53,7 +53,7 @@ void get_edge_and_target(size_t *leftedge, size_t *target_column)
 {
 #ifndef NANO_TINY
     if (ISSET(SOFTWRAP)) {
-	size_t realspan = strlenpt(openfile->current->data);
+	size_t realspan = line_width(openfile->current);
 
 	if (realspan > openfile->placewewant)
 	    realspan = openfile->placewewant;
@@ -181,7 +181,7 @@ void do_para_end(bool update_screen)
 	openfile->current = openfile->current->next;
 	openfile->current_x = 0;
     } else
-	openfile->current_x = strlen(openfile->current->data);
+	openfile->current_x = line_length(openfile->current);
 
     if (update_screen)
 	edit_redraw(was_current);
@@ -249,7 +249,7 @@ void do_prev_word(bool allow_punct, bool update_screen)
 	    if (openfile->current->prev == NULL)
 		break;
 	    openfile->current = openfile->current->prev;
-	    openfile->current_x = strlen(openfile->current->data);
+	    openfile->current_x = line_length(openfile->current);
 	}
 
 	/* Step back one character. */
@@ -297,6 +297,18 @@ bool do_next_word(bool allow_punct, bool update_screen)
     bool started_on_word = is_word_mbchar(openfile->current->data +
 				openfile->current_x, allow_punct);
     bool seen_space = !started_on_word;
+#ifndef NANO_TINY
+    unsigned int wordbits = CHARMAP_BIT(0x80);
+	/* The line-index bits of all bytes that can be part of a word. */
+    char symbol[2] = "";
+    int byte;
+
+    for (byte = 1; byte < 0x80; byte++) {
+	symbol[0] = byte;
+	if (is_word_mbchar(symbol, allow_punct))
+	    wordbits |= CHARMAP_BIT(byte);
+    }
+#endif
 
     /* Move forward until we reach the start of a word. */
     while (TRUE) {
@@ -308,6 +320,12 @@ bool do_next_word(bool allow_punct, bool update_screen)
 	    openfile->current = openfile->current->next;
 	    openfile->current_x = 0;
 	    seen_space = TRUE;
+#ifndef NANO_TINY
+	    /* Pass over lines that cannot hold a word, such as blank ones. */
+	    while (openfile->current->next != NULL &&
+			!line_may_contain(openfile->current, wordbits, FALSE))
+		openfile->current = openfile->current->next;
+#endif
 	} else {
 	    /* Step forward one character. */
 	    openfile->current_x = move_mbright(openfile->current->data,
@@ -412,7 +430,7 @@ void do_end(bool be_clever)
 {
     filestruct *was_current = openfile->current;
     size_t was_column = openfile->placewewant;
-    size_t line_len = strlen(openfile->current->data);
+    size_t line_len = line_length(openfile->current);
     bool moved_off_chunk = TRUE;
 
 #ifndef NANO_TINY
@@ -628,3 +646,144 @@ void do_right(void)
     if (line_needs_update(was_column, openfile->placewewant))
 	update_line(openfile->current, openfile->current_x);
 }
+
+#ifndef NANO_TINY
+/* Remember the given position in the jump history of the current buffer,
+ * dropping any positions that were gone back over, and the oldest one when
+ * the ring is full. */
+void push_anchor(filestruct *line, size_t x)
+{
+    anchorstruct *last;
+
+    if (openfile->anchors == NULL)
+	openfile->anchors = (anchorstruct *)nmalloc(MAX_ANCHORS *
+					sizeof(anchorstruct));
+
+    openfile->anchor_count = openfile->anchor_here;
+
+    /* Don't remember the same position twice in a row. */
+    if (openfile->anchor_count > 0) {
+	last = &openfile->anchors[(openfile->anchor_first +
+			openfile->anchor_count - 1) % MAX_ANCHORS];
+	if (last->line == line && last->x == x)
+	    return;
+    }
+
+    if (openfile->anchor_count == MAX_ANCHORS) {
+	openfile->anchor_first = (openfile->anchor_first + 1) % MAX_ANCHORS;
+	openfile->anchor_count--;
+    }
+
+    last = &openfile->anchors[(openfile->anchor_first +
+			openfile->anchor_count) % MAX_ANCHORS];
+    last->line = line;
+    last->x = x;
+
+    openfile->anchor_count++;
+    openfile->anchor_here = openfile->anchor_count;
+}
+
+/* Move the remembered positions that are on line at or after byte from_x
+ * to the line to, shifting them by shift bytes.  This keeps the jump
+ * history valid when lines are split, joined, or removed. */
+void move_anchors(filestruct *line, size_t from_x, filestruct *to,
+	ssize_t shift)
+{
+    size_t i;
+
+    for (i = 0; i < openfile->anchor_count; i++) {
+	anchorstruct *spot = &openfile->anchors[(openfile->anchor_first + i) %
+						MAX_ANCHORS];
+
+	if (spot->line != line || spot->x < from_x)
+	    continue;
+
+	spot->line = to;
+	spot->x = (shift < 0 && spot->x < (size_t)-shift) ? 0 : spot->x + shift;
+    }
+}
+
+/* Collapse the remembered positions between (top, top_x) and (bot, bot_x)
+ * onto top, as if that region had been removed, so that they can be moved
+ * to wherever the remainder of the two lines ends up. */
+void gather_anchors(filestruct *top, size_t top_x, filestruct *bot,
+	size_t bot_x)
+{
+    size_t i;
+
+    for (i = 0; i < openfile->anchor_count; i++) {
+	anchorstruct *spot = &openfile->anchors[(openfile->anchor_first + i) %
+						MAX_ANCHORS];
+
+	if (spot->line == NULL || line_number(spot->line) < line_number(top) ||
+			line_number(spot->line) > line_number(bot))
+	    continue;
+
+	if (spot->line == bot && spot->x >= bot_x)
+	    spot->x = top_x + spot->x - bot_x;
+	else if (spot->line != top || spot->x > top_x)
+	    spot->x = top_x;
+
+	spot->line = top;
+    }
+}
+
+/* Put the cursor on the remembered position with the given index. */
+void go_to_anchor(size_t index)
+{
+    anchorstruct *spot = &openfile->anchors[(openfile->anchor_first + index) %
+						MAX_ANCHORS];
+    filestruct *was_current = openfile->current;
+    size_t line_len;
+
+    if (spot->line == NULL) {
+	statusbar(_("That position is gone"));
+	return;
+    }
+
+    /* Edits within the line may have left the offset beyond its end,
+     * or in the middle of a character. */
+    line_len = strlen(spot->line->data);
+    if (spot->x > line_len)
+	spot->x = line_len;
+
+    openfile->current = spot->line;
+    openfile->current_x = actual_x(spot->line->data,
+				strnlenpt(spot->line->data, spot->x));
+
+    edit_redraw(was_current);
+}
+
+/* Go back to the position where the previous jump or search started. */
+void do_anchor_back(void)
+{
+    if (openfile->anchor_here == 0) {
+	statusbar(_("No earlier position"));
+	return;
+    }
+
+    /* When leaving the present, remember it, so that going forward can
+     * return to it. */
+    if (openfile->anchor_here == openfile->anchor_count) {
+	push_anchor(openfile->current, openfile->current_x);
+	openfile->anchor_here--;
+	if (openfile->anchor_here == 0) {
+	    statusbar(_("No earlier position"));
+	    return;
+	}
+    }
+
+    go_to_anchor(--openfile->anchor_here);
+}
+
+/* Go forward again to the position that was gone back from. */
+void do_anchor_forward(void)
+{
+    if (openfile->anchor_here + 1 >= openfile->anchor_count) {
+	statusbar(_("No later position"));
+	return;
+    }
+
+    go_to_anchor(++openfile->anchor_here);
+}
+#endif /* !NANO_TINY */
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdint.h>
 #include <ctype.h>
 #include <locale.h>
 #ifdef ENABLE_UTF8
@@ -40,6 +41,9 @@
 #ifndef NANO_TINY
 #include <sys/ioctl.h>
 #endif
+#ifdef USING_MMAP
+#include <sys/mman.h>
+#endif
 
 #ifdef ENABLE_MOUSE
 static int oldinterval = -1;
@@ -62,36 +66,224 @@ static struct sigaction act;
 static bool input_was_aborted = FALSE;
 	/* Whether reading from standard input was aborted via ^C. */
 
+static nodeslab *roomy_slabs = NULL;
+	/* The slabs that have free nodes, the one with the latest freed
+	 * node first. */
+#ifdef USING_MMAP
+static mapstruct *mappings = NULL;
+	/* The memory mappings into which files were read and that still hold
+	 * the text of some lines. */
+#endif
+
+/* Get memory for a line node.  Nodes are carved from slabs of SLAB_SIZE
+ * bytes, so that reading or freeing a big file costs a malloc() or free()
+ * per slab instead of one per line. */
+filestruct *take_node(void)
+{
+    nodeslab *slab = roomy_slabs;
+    filestruct *node;
+
+    if (slab == NULL) {
+	void *memory;
+
+	if (posix_memalign(&memory, SLAB_SIZE, SLAB_SIZE) != 0)
+	    die(_("nano is out of memory!"));
+
+	slab = (nodeslab *)memory;
+
+	slab->prev = NULL;
+	slab->next = NULL;
+	slab->spare = NULL;
+	slab->used = 0;
+	slab->fresh = NODES_PER_SLAB;
+
+	roomy_slabs = slab;
+    }
+
+    /* Prefer a node that was given back; otherwise carve the next one in
+     * address order, so that the pages of a slab get touched only when
+     * they are needed. */
+    if (slab->spare != NULL) {
+	node = slab->spare;
+	slab->spare = node->next;
+    } else
+	node = (filestruct *)(slab + 1) + (NODES_PER_SLAB - slab->fresh--);
+    slab->used++;
+
+    /* When the slab is full, take it off the list. */
+    if (slab->spare == NULL && slab->fresh == 0) {
+	roomy_slabs = slab->next;
+	if (roomy_slabs != NULL)
+	    roomy_slabs->prev = NULL;
+    }
+
+    return node;
+}
+
+/* Return the memory of a line node to its slab, and free the slab when none
+ * of its nodes are in use anymore -- unless it is the only one with room. */
+void give_back_node(filestruct *node)
+{
+    nodeslab *slab = (nodeslab *)((uintptr_t)node & ~(uintptr_t)(SLAB_SIZE - 1));
+
+    /* A full slab gets room again, so put it on the list. */
+    if (slab->spare == NULL && slab->fresh == 0) {
+	slab->prev = NULL;
+	slab->next = roomy_slabs;
+	if (roomy_slabs != NULL)
+	    roomy_slabs->prev = slab;
+	roomy_slabs = slab;
+    }
+
+    node->next = slab->spare;
+    slab->spare = node;
+    slab->used--;
+
+    if (slab->used > 0 || (slab->prev == NULL && slab->next == NULL))
+	return;
+
+    if (slab->prev != NULL)
+	slab->prev->next = slab->next;
+    else
+	roomy_slabs = slab->next;
+    if (slab->next != NULL)
+	slab->next->prev = slab->prev;
+
+    free(slab);
+}
+
 /* Create a new linestruct node.  Note that we do not set prevnode->next
  * to the new line. */
 filestruct *make_new_node(filestruct *prevnode)
 {
-    filestruct *newnode = nmalloc(sizeof(filestruct));
+    filestruct *newnode = take_node();
 
     newnode->data = NULL;
+    newnode->store.twin = NULL;
     newnode->prev = prevnode;
     newnode->next = NULL;
-    newnode->lineno = (prevnode != NULL) ? prevnode->lineno + 1 : 1;
+    newnode->lineno = (prevnode != NULL) ? line_number(prevnode) + 1 : 1;
+    newnode->epoch = (prevnode != NULL) ? prevnode->epoch : 0;
+    newnode->length = NOT_KNOWN;
+    newnode->width = NOT_KNOWN;
 
 #ifndef DISABLE_COLOR
-    newnode->multidata = NULL;
+    newnode->multidata = 0;
+#endif
+#ifndef NANO_TINY
+    newnode->charmap = 0;
 #endif
 
     return newnode;
 }
 
-/* Make a copy of a linestruct node. */
-filestruct *copy_node(const filestruct *src)
+/* Return TRUE when the text of the given line is kept inside the node
+ * itself instead of in a separate allocation. */
+static bool inside_node(const filestruct *line)
+{
+    return (line->data >= line->store.tiny &&
+		line->data < line->store.tiny + sizeof(line->store.tiny));
+}
+
+#ifdef USING_MMAP
+/* Return the file mapping in which the given text lies, or NULL when the
+ * text lies in none. */
+static mapstruct *mapping_of(const char *text)
 {
-    filestruct *dst = nmalloc(sizeof(filestruct));
+    mapstruct *map;
+
+    for (map = mappings; map != NULL; map = map->next)
+	if (text >= map->start && text < map->start + map->size)
+	    return map;
+
+    return NULL;
+}
+
+/* Note that one line fewer has its text in the given file mapping, and
+ * unmap it when no line has. */
+static void let_go_of(mapstruct *map)
+{
+    mapstruct **link = &mappings;
+
+    if (--map->users > 0)
+	return;
+
+    while (*link != map)
+	link = &(*link)->next;
+    *link = map->next;
+
+    munmap(map->start, map->size);
+    free(map);
+}
+
+/* Take note of a memory mapping at start into which a file was read, and
+ * whose text is now used by the given number of lines. */
+void adopt_mapping(char *start, size_t size, size_t users)
+{
+    mapstruct *map;
+
+    if (users == 0) {
+	munmap(start, size);
+	return;
+    }
 
-    dst->data = mallocstrcpy(NULL, src->data);
+    map = (mapstruct *)nmalloc(sizeof(mapstruct));
+    map->start = start;
+    map->size = size;
+    map->users = users;
+    map->next = mappings;
+    mappings = map;
+}
+#endif /* USING_MMAP */
+
+/* Give the given fresh line a copy of the given text: inside the node
+ * when the text is short enough, in a separate allocation otherwise. */
+void set_text(filestruct *line, const char *text)
+{
+    if (strlen(text) < sizeof(line->store.tiny)) {
+	strcpy(line->store.tiny, text);
+	line->data = line->store.tiny;
+    } else {
+	line->data = mallocstrcpy(NULL, text);
+	line->store.twin = NULL;
+    }
+}
+
+/* Make a copy of a linestruct node.  The copy shares the text of the
+ * original, until one of the two gets changed. */
+filestruct *copy_node(filestruct *src)
+{
+    filestruct *dst = take_node();
+#ifdef USING_MMAP
+    mapstruct *map;
+#endif
+
+    if (inside_node(src))
+	set_text(dst, src->data);
+#ifdef USING_MMAP
+    else if ((map = mapping_of(src->data)) != NULL) {
+	dst->data = src->data;
+	dst->store.twin = NULL;
+	map->users++;
+    }
+#endif
+    else {
+	dst->data = src->data;
+	dst->store.twin = (src->store.twin != NULL) ? src->store.twin : src;
+	src->store.twin = dst;
+    }
     dst->next = src->next;
     dst->prev = src->prev;
     dst->lineno = src->lineno;
+    dst->epoch = src->epoch;
+    dst->length = src->length;
+    dst->width = src->width;
 
 #ifndef DISABLE_COLOR
-    dst->multidata = NULL;
+    dst->multidata = 0;
+#endif
+#ifndef NANO_TINY
+    dst->charmap = 0;
 #endif
 
     return dst;
@@ -123,21 +315,99 @@ void unlink_node(filestruct *fileptr)
     if (openfile && openfile->filebot == fileptr)
 	openfile->filebot = fileptr->prev;
 
+#ifndef NANO_TINY
+    /* Keep no remembered positions on the node that goes away. */
+    if (openfile)
+	move_anchors(fileptr, 0, (fileptr->next != NULL) ?
+				fileptr->next : fileptr->prev, 0);
+#endif
+
     delete_node(fileptr);
 }
 
+/* Take the given node out of the ring of nodes that share its text. */
+static void leave_twins(filestruct *line)
+{
+    filestruct *before = line->store.twin;
+
+    while (before->store.twin != line)
+	before = before->store.twin;
+
+    /* When only one other node remains, its text becomes its own. */
+    before->store.twin = (line->store.twin == before) ?
+				NULL : line->store.twin;
+    line->store.twin = NULL;
+}
+
+/* Give the given line a private, heap-allocated copy of its text, if it
+ * shares the text with other lines, or keeps it inside the node or in a
+ * file mapping, so that the text can be changed.  This must be done before
+ * any change to the text of a line that may come from a copy or a file. */
+void unshare_line(filestruct *line)
+{
+#ifdef USING_MMAP
+    mapstruct *map;
+#endif
+
+    if (inside_node(line)) {
+	line->data = mallocstrcpy(NULL, line->data);
+	line->store.twin = NULL;
+	return;
+    }
+
+#ifdef USING_MMAP
+    if ((map = mapping_of(line->data)) != NULL) {
+	line->data = mallocstrcpy(NULL, line->data);
+	let_go_of(map);
+	return;
+    }
+#endif
+
+    if (line->store.twin == NULL)
+	return;
+
+    leave_twins(line);
+    line->data = mallocstrcpy(NULL, line->data);
+}
+
+/* Let go of the text of the given line: free it, unless other lines
+ * still share it or it is kept inside the node or in a file mapping. */
+void release_text(filestruct *line)
+{
+#ifdef USING_MMAP
+    mapstruct *map;
+#endif
+
+    if (inside_node(line))
+	line->store.twin = NULL;
+#ifdef USING_MMAP
+    else if ((map = mapping_of(line->data)) != NULL)
+	let_go_of(map);
+#endif
+    else if (line->store.twin != NULL)
+	leave_twins(line);
+    else
+	free(line->data);
+}
+
 /* Free the data structures in the given node. */
 void delete_node(filestruct *fileptr)
 {
-    free(fileptr->data);
-#ifndef DISABLE_COLOR
-    free(fileptr->multidata);
-#endif
-    free(fileptr);
+    /* If the node is in the line index of the current buffer, drop it. */
+    if (openfile != NULL && (fileptr->lineno - 1) % LINE_STRIDE == 0) {
+	size_t slot = (fileptr->lineno - 1) / LINE_STRIDE;
+
+	if (slot < openfile->index_size && openfile->lineindex[slot] == fileptr)
+	    openfile->lineindex[slot] = NULL;
+    }
+
+    release_text(fileptr);
+    give_back_node(fileptr);
 }
 
-/* Duplicate an entire linked list of linestructs. */
-filestruct *copy_filestruct(const filestruct *src)
+/* Duplicate an entire linked list of linestructs.  The text of the lines
+ * is not copied but shared. */
+filestruct *copy_filestruct(filestruct *src)
 {
     filestruct *head, *copy;
 
@@ -173,20 +443,193 @@ void free_filestruct(filestruct *src)
     delete_node(src);
 }
 
-/* Renumber the lines in a buffer, starting with fileptr. */
+/* Put the given line into the given slot of the line index of the
+ * current buffer, making room for it when needed. */
+void store_in_index(filestruct *line, size_t slot)
+{
+    if (slot >= openfile->index_size) {
+	openfile->index_size = slot * 2 + 16;
+	openfile->lineindex = (filestruct **)nrealloc(openfile->lineindex,
+				openfile->index_size * sizeof(filestruct *));
+    }
+
+    openfile->lineindex[slot] = line;
+}
+
+/* Forget the entries in the line index of the current buffer that are
+ * for line number lineno or later. */
+void forget_index_from(ssize_t lineno)
+{
+    size_t keep = (lineno > 1) ? (lineno - 2) / LINE_STRIDE + 1 : 0;
+
+    if (openfile->index_count > keep)
+	openfile->index_count = keep;
+}
+
+/* Return the indexed line closest to and not after line number lineno
+ * in the current buffer, first extending the index when it does not
+ * reach that far yet.  Return NULL when lineno is out of range. */
+filestruct *closest_indexed_line(ssize_t lineno)
+{
+    size_t slot;
+    filestruct *line;
+
+    if (lineno < 1 || filepart != NULL)
+	return NULL;
+
+    slot = (lineno - 1) / LINE_STRIDE;
+
+    if (slot < openfile->index_count) {
+	line = openfile->lineindex[slot];
+	if (line != NULL && line_number(line) == slot * LINE_STRIDE + 1)
+	    return line;
+	openfile->index_count = slot;
+    }
+
+    /* Drop trailing entries whose lines were deleted or moved. */
+    while (openfile->index_count > 0) {
+	line = openfile->lineindex[openfile->index_count - 1];
+	if (line != NULL && line_number(line) ==
+			(openfile->index_count - 1) * LINE_STRIDE + 1)
+	    break;
+	openfile->index_count--;
+    }
+
+    if (openfile->index_count == 0) {
+	line = openfile->fileage;
+	store_in_index(line, 0);
+	openfile->index_count = 1;
+    }
+
+    /* Walk on from the last entry, noting every LINE_STRIDE-th line
+     * and setting its number straight while at it. */
+    while (openfile->index_count <= slot) {
+	filestruct *ahead = line;
+	size_t steps = 0;
+
+	while (steps < LINE_STRIDE && ahead->next != NULL) {
+	    ahead = ahead->next;
+	    steps++;
+	}
+
+	if (steps < LINE_STRIDE)
+	    break;
+
+	line = ahead;
+	line->lineno = openfile->index_count * LINE_STRIDE + 1;
+	line->epoch = openfile->shift_base + openfile->shift_count;
+	store_in_index(line, openfile->index_count++);
+    }
+
+    return line;
+}
+
+/* Renumber the lines in a buffer, starting with fileptr.  When these are
+ * lines of the current buffer, update its line index along the way. */
 void renumber(filestruct *fileptr)
 {
+    filestruct *first = fileptr, *last = NULL;
     ssize_t line;
+    size_t epoch = 0;
+    bool indexing = FALSE;
 
     if (fileptr == NULL)
 	return;
 
-    line = (fileptr->prev == NULL) ? 0 : fileptr->prev->lineno;
+    line = (fileptr->prev == NULL) ? 0 : line_number(fileptr->prev);
 
     assert(fileptr != fileptr->next);
 
-    for (; fileptr != NULL; fileptr = fileptr->next)
+    if (openfile != NULL && filepart != NULL)
+	/* The lines of a partition of the current buffer get numbered
+	 * anew, so the index entries that may point at them are void. */
+	forget_index_from(line_number(fileptr));
+    else if (openfile != NULL && (fileptr->prev == NULL ?
+		fileptr == openfile->fileage : fileptr->prev->epoch > 0)) {
+	/* These seem to be lines of the current buffer; index them,
+	 * if the index reaches this far. */
+	forget_index_from(line + 1);
+	indexing = (openfile->index_count == (line + LINE_STRIDE - 1) /
+							LINE_STRIDE);
+	epoch = openfile->shift_base + openfile->shift_count;
+    }
+
+    for (; fileptr != NULL; fileptr = fileptr->next) {
+	fileptr->lineno = ++line;
+	fileptr->epoch = epoch;
+	if (indexing && (line - 1) % LINE_STRIDE == 0)
+	    store_in_index(fileptr, (line - 1) / LINE_STRIDE);
+	last = fileptr;
+    }
+
+    if (openfile != NULL && filepart == NULL && last == openfile->filebot) {
+	if (epoch == 0)
+	    for (fileptr = first; fileptr != NULL; fileptr = fileptr->next)
+		fileptr->epoch = openfile->shift_base + openfile->shift_count;
+	if (indexing)
+	    openfile->index_count = (line - 1) / LINE_STRIDE + 1;
+    } else if (epoch > 0)
+	/* It was some other list after all: its numbers need no shifts. */
+	for (fileptr = first; fileptr != NULL; fileptr = fileptr->next)
+	    fileptr->epoch = 0;
+}
+
+/* Number the lines from first through last of the current buffer, which
+ * were just added or changed, and record by how much the lines after
+ * them have moved, without touching those lines: they get their proper
+ * number the next time that it is asked for. */
+void renumber_span(filestruct *first, filestruct *last)
+{
+    filestruct *fileptr, *after;
+    ssize_t line, was, count = 0;
+    size_t epoch;
+
+    if (first == NULL)
+	return;
+
+    /* Number lines outside of the buffer proper in the plain way. */
+    if (openfile == NULL || filepart != NULL) {
+	renumber(first);
+	return;
+    }
+
+    after = last->next;
+    line = (first->prev == NULL) ? 0 : line_number(first->prev);
+    was = (after == NULL) ? 0 : line_number(after);
+
+    forget_index_from(line + 1);
+
+    for (fileptr = first; fileptr != after; fileptr = fileptr->next)
+	count++;
+
+    /* When the lines after the span have moved, record this as a shift;
+     * when there is no more room for shifts, renumber everything. */
+    if (after != NULL && was != line + count + 1) {
+	if (openfile->shift_count == MAX_SHIFTS) {
+	    openfile->shift_base += openfile->shift_count;
+	    openfile->shift_count = 0;
+	    /* Start counting anew before the epochs outgrow their field. */
+	    if (openfile->shift_base > MAX_EPOCH)
+		openfile->shift_base = 1;
+	    renumber(openfile->fileage);
+	    return;
+	}
+
+	if (openfile->shifts == NULL)
+	    openfile->shifts = (shiftstruct *)nmalloc(MAX_SHIFTS *
+						sizeof(shiftstruct));
+
+	openfile->shifts[openfile->shift_count].from = was;
+	openfile->shifts[openfile->shift_count].delta = line + count + 1 - was;
+	openfile->shift_count++;
+    }
+
+    epoch = openfile->shift_base + openfile->shift_count;
+
+    for (fileptr = first; fileptr != after; fileptr = fileptr->next) {
 	fileptr->lineno = ++line;
+	fileptr->epoch = epoch;
+    }
 }
 
 /* Partition the current buffer so that it appears to begin at (top, top_x)
@@ -228,12 +671,18 @@ partition *partition_filestruct(filestruct *top, size_t top_x,
     bot->next = NULL;
     p->bot_data = mallocstrcpy(NULL, bot->data + bot_x);
 
+    unshare_line(top);
+    unshare_line(bot);
+
     /* Remove all text after bot_x at the bottom of the partition. */
     bot->data[bot_x] = '\0';
 
     /* Remove all text before top_x at the top of the partition. */
     charmove(top->data, top->data + top_x, strlen(top->data) - top_x + 1);
 
+    invalidate_line(top);
+    invalidate_line(bot);
+
     /* Return the partition. */
     return p;
 }
@@ -250,12 +699,14 @@ void unpartition_filestruct(partition **p)
     openfile->fileage->prev = (*p)->top_prev;
     if (openfile->fileage->prev != NULL)
 	openfile->fileage->prev->next = openfile->fileage;
+    unshare_line(openfile->fileage);
     openfile->fileage->data = charealloc(openfile->fileage->data,
 		strlen((*p)->top_data) + strlen(openfile->fileage->data) + 1);
     charmove(openfile->fileage->data + strlen((*p)->top_data),
 		openfile->fileage->data, strlen(openfile->fileage->data) + 1);
     strncpy(openfile->fileage->data, (*p)->top_data, strlen((*p)->top_data));
     free((*p)->top_data);
+    invalidate_line(openfile->fileage);
 
     /* Reattach the line below the bottom of the partition, and restore
      * the text after bot_x from bot_data.  Free bot_data when we're
@@ -263,10 +714,12 @@ void unpartition_filestruct(partition **p)
     openfile->filebot->next = (*p)->bot_next;
     if (openfile->filebot->next != NULL)
 	openfile->filebot->next->prev = openfile->filebot;
+    unshare_line(openfile->filebot);
     openfile->filebot->data = charealloc(openfile->filebot->data,
 		strlen(openfile->filebot->data) + strlen((*p)->bot_data) + 1);
     strcat(openfile->filebot->data, (*p)->bot_data);
     free((*p)->bot_data);
+    invalidate_line(openfile->filebot);
 
     /* Restore the top and bottom of the buffer, if they were
      * different from the top and bottom of the partition. */
@@ -300,19 +753,26 @@ void extract_buffer(filestruct **file_top, filestruct **file_bot,
     if (top == bot && top_x == bot_x)
 	return;
 
+#ifndef NANO_TINY
+    /* The remembered positions in the text will end up at its start. */
+    gather_anchors(top, top_x, bot, bot_x);
+#endif
+
     /* Partition the buffer so that it contains only the text from
      * (top, top_x) to (bot, bot_x), keep track of whether the top of
      * the edit window is inside the partition, and keep track of
      * whether the mark begins inside the partition. */
     filepart = partition_filestruct(top, top_x, bot, bot_x);
-    edittop_inside = (openfile->edittop->lineno >= openfile->fileage->lineno &&
-			openfile->edittop->lineno <= openfile->filebot->lineno);
+    edittop_inside = (line_number(openfile->edittop) >=
+			line_number(openfile->fileage) &&
+			line_number(openfile->edittop) <=
+			line_number(openfile->filebot));
 #ifndef NANO_TINY
     if (openfile->mark_set) {
-	mark_inside = (openfile->mark_begin->lineno >=
-		openfile->fileage->lineno &&
-		openfile->mark_begin->lineno <=
-		openfile->filebot->lineno &&
+	mark_inside = (line_number(openfile->mark_begin) >=
+		line_number(openfile->fileage) &&
+		line_number(openfile->mark_begin) <=
+		line_number(openfile->filebot) &&
 		(openfile->mark_begin != openfile->fileage ||
 		openfile->mark_begin_x >= top_x) &&
 		(openfile->mark_begin != openfile->filebot ||
@@ -338,10 +798,12 @@ void extract_buffer(filestruct **file_top, filestruct **file_bot,
 
 	/* Otherwise, tack the text in top onto the text at the end of
 	 * file_bot. */
+	unshare_line(*file_bot);
 	(*file_bot)->data = charealloc((*file_bot)->data,
 		strlen((*file_bot)->data) +
 		strlen(openfile->fileage->data) + 1);
 	strcat((*file_bot)->data, openfile->fileage->data);
+	invalidate_line(*file_bot);
 
 	/* Attach the line after top to the line after file_bot.  Then,
 	 * if there's more than one line after top, move file_bot down
@@ -369,6 +831,8 @@ void extract_buffer(filestruct **file_top, filestruct **file_bot,
     openfile->current = openfile->fileage;
     openfile->current_x = top_x;
 #ifndef NANO_TINY
+    move_anchors(top, 0, openfile->current, 0);
+
     if (mark_inside) {
 	openfile->mark_begin = openfile->current;
 	openfile->mark_begin_x = openfile->current_x;
@@ -390,8 +854,9 @@ void extract_buffer(filestruct **file_top, filestruct **file_bot,
 	refresh_needed = TRUE;
     }
 
-    /* Renumber, starting with the beginning line of the old partition. */
-    renumber(top_save);
+    /* Renumber the line where the text was cut, and let the lines after it
+     * follow suit. */
+    renumber_span(top_save, top_save);
 
     /* If the text doesn't end with a magicline, and it should, add one. */
     if (!ISSET(NO_NEWLINES) && openfile->filebot->data[0] != '\0')
@@ -402,10 +867,11 @@ void extract_buffer(filestruct **file_top, filestruct **file_bot,
  * at the current cursor position. */
 void ingraft_buffer(filestruct *somebuffer)
 {
-    filestruct *top_save;
+    filestruct *top_save, *bot_save;
     size_t current_x_save = openfile->current_x;
     bool edittop_inside;
 #ifndef NANO_TINY
+    filestruct *current_save = openfile->current;
     bool right_side_up = FALSE, single_line = FALSE;
 #endif
 
@@ -468,6 +934,14 @@ void ingraft_buffer(filestruct *somebuffer)
     }
 #endif
 
+#ifndef NANO_TINY
+    /* The line that the cursor was on has been freed; move the remembered
+     * positions on it to before and after the pasted text. */
+    move_anchors(current_save, current_x_save + 1, openfile->current,
+			openfile->current_x - current_x_save);
+    move_anchors(current_save, 0, openfile->fileage, 0);
+#endif
+
     /* Add the number of characters in the copied text to the file size. */
     openfile->totsize += get_totsize(openfile->fileage, openfile->filebot);
 
@@ -477,13 +951,14 @@ void ingraft_buffer(filestruct *somebuffer)
 	openfile->edittop = openfile->fileage;
 
     top_save = openfile->fileage;
+    bot_save = openfile->filebot;
 
     /* Unpartition the buffer so that it contains all the text
      * again, plus the copied text. */
     unpartition_filestruct(&filepart);
 
-    /* Renumber, starting with the beginning line of the old partition. */
-    renumber(top_save);
+    /* Renumber the pasted lines, and let the lines after them follow. */
+    renumber_span(top_save, bot_save);
 
     /* If the text doesn't end with a magicline, and it should, add one. */
     if (!ISSET(NO_NEWLINES) && openfile->filebot->data[0] != '\0')
@@ -520,9 +995,12 @@ void delete_opennode(openfilestruct *fileptr)
 {
     free(fileptr->filename);
     free_filestruct(fileptr->fileage);
+    free(fileptr->lineindex);
+    free(fileptr->shifts);
 #ifndef NANO_TINY
     free(fileptr->current_stat);
     free(fileptr->lock_filename);
+    free(fileptr->anchors);
     /* Free the undo stack. */
     discard_until(NULL, fileptr);
 #endif
@@ -567,7 +1045,8 @@ void finish(void)
     if (ISSET(HISTORYLOG))
 	save_history();
     if (ISSET(POS_HISTORY)) {
-	update_poshistory(openfile->filename, openfile->current->lineno, xplustabs() + 1);
+	update_poshistory(openfile->filename, line_number(openfile->current),
+				xplustabs() + 1);
 	save_poshistory();
     }
 #endif
@@ -652,7 +1131,7 @@ void die_save_file(const char *die_filename, struct stat *die_stat)
     targetname = get_next_filename(die_filename, ".save");
 
     if (*targetname != '\0')
-	failed = !write_file(targetname, NULL, TRUE, OVERWRITE, TRUE);
+	failed = !write_file(targetname, NULL, TRUE, OVERWRITE, TRUE, NULL);
 
     if (!failed)
 	fprintf(stderr, _("\nBuffer written to %s\n"), targetname);
@@ -708,6 +1187,12 @@ void window_init(void)
 	bottomwin = newwin(bottomrows, COLS, toprows + editwinrows, 0);
     }
 
+    /* Size the screen map to the new edit window; it gets filled in
+     * again by the next full refresh. */
+    screenmap = (screenrow *)nrealloc(screenmap,
+				editwinrows * sizeof(screenrow));
+    memset(screenmap, 0, editwinrows * sizeof(screenrow));
+
     /* In case the terminal shrunk, make sure the status line is clear. */
     blank_statusbar();
     wnoutrefresh(bottomwin);
@@ -1751,6 +2236,8 @@ int do_mouse(void)
     /* If the click was in the edit window, put the cursor in that spot. */
     if (wmouse_trafo(edit, &mouse_row, &mouse_col, FALSE)) {
 	filestruct *current_save = openfile->current;
+	const screenrow *spot = mapped_row(mouse_row);
+	    /* What the screen map says was drawn on the clicked row. */
 	ssize_t row_count = mouse_row - openfile->current_y;
 	size_t leftedge;
 #ifndef NANO_TINY
@@ -1768,8 +2255,13 @@ int do_mouse(void)
 	fprintf(stderr, "mouse_row = %d, current_y = %ld\n", mouse_row, (long)openfile->current_y);
 #endif
 
-	/* Move current up or down to the row corresponding to mouse_row. */
-	if (row_count < 0)
+	/* When the row shows text, go straight to the line and chunk drawn
+	 * there; otherwise move current up or down to the row corresponding
+	 * to mouse_row, which stops at the last line. */
+	if (spot != NULL) {
+	    openfile->current = spot->line;
+	    leftedge = spot->leftedge;
+	} else if (row_count < 0)
 	    go_back_chunks(-row_count, &openfile->current, &leftedge);
 	else
 	    go_forward_chunks(row_count, &openfile->current, &leftedge);
@@ -1800,33 +2292,81 @@ int do_mouse(void)
  * TRUE. */
 void do_output(char *output, size_t output_len, bool allow_cntrls)
 {
-    char onechar[MAXCHARLEN];
+    char *run = charalloc(output_len);
+	/* The characters that get added in one go. */
+    size_t run_len, run_chars;
+	/* The length of the run in bytes, and in characters. */
     int char_len;
-    size_t current_len = strlen(openfile->current->data);
-    size_t i = 0;
+    size_t current_len = line_length(openfile->current);
+    size_t i = 0, j;
+#ifndef DISABLE_WRAPPING
+    size_t headroom = 0, column;
+	/* How many columns the line can surely still grow without needing
+	 * a wrap, and the width of the character that gets added. */
+#endif
 #ifndef NANO_TINY
     size_t orig_rows = 0, original_row = 0;
 
     if (ISSET(SOFTWRAP)) {
 	if (openfile->current_y == editwinrows - 1)
 	    original_row = xplustabs() / editwincols;
-	orig_rows = strlenpt(openfile->current->data) / editwincols;
+	orig_rows = line_width(openfile->current) / editwincols;
     }
 #endif
 
     while (i < output_len) {
-	/* Encode an embedded NUL byte as 0x0A. */
-	if (output[i] == '\0')
-	    output[i] = '\n';
+	run_len = 0;
+	run_chars = 0;
 
-	/* Get the next multibyte character. */
-	char_len = parse_mbchar(output + i, onechar, NULL);
+#ifndef DISABLE_WRAPPING
+	/* Shifting the tail of the line can widen a tab in it by nearly
+	 * a full tab, so leave room for that. */
+	if (!ISSET(NO_WRAP)) {
+	    column = line_width(openfile->current) + tabsize;
+	    headroom = ((ssize_t)column < fill) ? fill - column : 0;
+	}
+#endif
 
-	i += char_len;
+	/* Gather as many characters as can be added without a line break
+	 * in between, so that the line gets enlarged and its tail moved
+	 * just once, however long the line is.  When the text may get
+	 * wrapped, the run ends where the line might get too wide, so
+	 * that the wrap check is done once per run. */
+	while (i < output_len) {
+	    /* Encode an embedded NUL byte as 0x0A. */
+	    if (output[i] == '\0')
+		output[i] = '\n';
 
-	/* If controls are not allowed, ignore an ASCII control character. */
-	if (!allow_cntrls && is_ascii_cntrl_char(*(output + i -	char_len)))
-	    continue;
+	    /* Get the next multibyte character. */
+	    char_len = parse_mbchar(output + i, run + run_len, NULL);
+
+	    i += char_len;
+
+	    /* If controls are not allowed, ignore an ASCII control character. */
+	    if (!allow_cntrls && is_ascii_cntrl_char(*(output + i - char_len)))
+		continue;
+
+	    run_len += char_len;
+	    run_chars++;
+
+#ifndef DISABLE_WRAPPING
+	    if (!ISSET(NO_WRAP)) {
+		/* A tab can take up to a full tab width, wherever it lands. */
+		column = 0;
+		if (run[run_len - char_len] == '\t')
+		    column = tabsize;
+		else
+		    parse_mbchar(run + run_len - char_len, NULL, &column);
+
+		if (column > headroom)
+		    break;
+		headroom -= column;
+	    }
+#endif
+	}
+
+	if (run_len == 0)
+	    break;
 
 	/* If we're adding to the magicline, create a new magicline. */
 	if (!ISSET(NO_NEWLINES) && openfile->filebot == openfile->current) {
@@ -1835,47 +2375,64 @@ void do_output(char *output, size_t output_len, bool allow_cntrls)
 		refresh_needed = TRUE;
 	}
 
-	/* Make room for the new character and copy it into the line. */
+	/* Make room for the new characters and copy them into the line. */
+	unshare_line(openfile->current);
 	openfile->current->data = charealloc(openfile->current->data,
-					current_len + char_len + 1);
-	charmove(openfile->current->data + openfile->current_x + char_len,
+					current_len + run_len + 1);
+	charmove(openfile->current->data + openfile->current_x + run_len,
 			openfile->current->data + openfile->current_x,
 			current_len - openfile->current_x + 1);
-	strncpy(openfile->current->data + openfile->current_x, onechar,
-			char_len);
-	current_len += char_len;
-	openfile->totsize++;
+	strncpy(openfile->current->data + openfile->current_x, run, run_len);
+	invalidate_line(openfile->current);
+	current_len += run_len;
+	if (current_len < NOT_KNOWN)
+	    openfile->current->length = current_len;
 	set_modified();
 
 #ifndef NANO_TINY
-	add_undo(ADD);
-
 	/* Note that current_x has not yet been incremented. */
 	if (openfile->mark_set && openfile->current == openfile->mark_begin &&
 		openfile->current_x < openfile->mark_begin_x)
-	    openfile->mark_begin_x += char_len;
-#endif
+	    openfile->mark_begin_x += run_len;
 
-	openfile->current_x += char_len;
+	move_anchors(openfile->current, openfile->current_x + 1,
+			openfile->current, run_len);
+#endif
 
+	/* Step over the added characters one by one, so that the undo
+	 * record grows in the same way as when they were typed. */
+	for (j = 0; j < run_chars; j++) {
+	    char_len = parse_mbchar(openfile->current->data +
+				openfile->current_x, NULL, NULL);
+	    openfile->totsize++;
 #ifndef NANO_TINY
-	update_undo(ADD);
+	    add_undo(ADD);
 #endif
+	    openfile->current_x += char_len;
+#ifndef NANO_TINY
+	    update_undo(ADD);
+#endif
+	}
 
 #ifndef DISABLE_WRAPPING
-	/* If text gets wrapped, the edit window needs a refresh. */
-	if (!ISSET(NO_WRAP) && do_wrap(openfile->current))
+	/* If text gets wrapped, the edit window needs a refresh, and the
+	 * cursor may be on another line now. */
+	if (!ISSET(NO_WRAP) && do_wrap(openfile->current)) {
+	    current_len = line_length(openfile->current);
 	    refresh_needed = TRUE;
+	}
 #endif
     }
 
+    free(run);
+
 #ifndef NANO_TINY
     /* If the number of screen rows that a softwrapped line occupies has
      * changed, we need a full refresh.  And if we were on the last line
      * of the edit window, and we moved one screen row, we're now below
      * the last line of the edit window, so we need a full refresh too. */
     if (ISSET(SOFTWRAP) && refresh_needed == FALSE &&
-		(strlenpt(openfile->current->data) / editwincols != orig_rows ||
+		(line_width(openfile->current) / editwincols != orig_rows ||
 		(openfile->current_y == editwinrows - 1 &&
 		xplustabs() / editwincols != original_row)))
 	refresh_needed = TRUE;
@@ -2586,7 +3143,7 @@ int main(int argc, char **argv)
 
     while (TRUE) {
 #ifdef ENABLE_LINENUMBERS
-	int needed_margin = digits(openfile->filebot->lineno) + 1;
+	int needed_margin = digits(line_number(openfile->filebot)) + 1;
 
 	/* Suppress line numbers when there is not enough room for them. */
 	if (!ISSET(LINE_NUMBERS) || needed_margin > COLS - 4)
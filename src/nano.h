@@ -67,6 +67,14 @@
 #define charmove(dest, src, n) memmove(dest, src, (n) * sizeof(char))
 #define charset(dest, src, n) memset(dest, src, (n) * sizeof(char))
 
+#ifndef NANO_TINY
+/* The bit that a byte occupies in the charmap of a line: letters are
+ * folded to lowercase, all bytes above 0x7F share the top bit, and the
+ * bottom bit merely says that the map has been computed. */
+#define CHARMAP_BIT(c) ((unsigned int)1 << (((unsigned char)(c) >= 0x80) ? 31 : \
+		1 + ((unsigned char)(c) | (((c) >= 'A' && (c) <= 'Z') ? 0x20 : 0)) % 30))
+#endif
+
 /* In UTF-8 a character is at most six bytes long. */
 #ifdef ENABLE_UTF8
 #define MAXCHARLEN 6
@@ -130,6 +138,11 @@
 #undef ENABLE_MOUSE
 #endif
 
+/* Read files in one go into memory mappings, where this is possible. */
+#if defined(HAVE_SYS_MMAN_H) && !defined(NANO_TINY)
+#define USING_MMAP yes
+#endif
+
 #if defined(DISABLE_WRAPPING) && defined(DISABLE_JUSTIFY)
 #define DISABLE_WRAPJUSTIFY 1
 #endif
@@ -245,37 +258,98 @@ typedef struct lintstruct {
 	/* Previous error. */
 } lintstruct;
 
-/* Flags that indicate how a multiline regex applies to a line. */
-#define CNONE		(1<<1)
+/* Values that indicate how a multiline regex applies to a line. */
+#define CNONE		1
 	/* Yay, regex doesn't apply to this line at all! */
-#define CBEGINBEFORE	(1<<2)
+#define CBEGINBEFORE	2
 	/* Regex starts on an earlier line, ends on this one. */
-#define CENDAFTER	(1<<3)
+#define CENDAFTER	3
 	/* Regex starts on this line and ends on a later one. */
-#define CWHOLELINE	(1<<4)
+#define CWHOLELINE	4
 	/* Whole line engulfed by the regex, start < me, end > me. */
-#define CSTARTENDHERE	(1<<5)
+#define CSTARTENDHERE	5
 	/* Regex starts and ends within this line. */
-#define CWOULDBE	(1<<6)
+#define CWOULDBE	6
 	/* An unpaired start match on or before this line. */
+
+/* The number of bits that hold one of the above values in the multidata
+ * of a line, and how many multiline regexes fit in there. */
+#define MULTI_BITS	3
+#define MAX_CACHED_MULTIS	(int)(sizeof(unsigned int) * 8 / MULTI_BITS)
 #endif /* !DISABLE_COLOR */
 
 /* More structure types. */
 typedef struct filestruct {
     char *data;
 	/* The text of this line. */
-    ssize_t lineno;
-	/* The number of this line. */
+    union {
+	struct filestruct *twin;
+	    /* The next node in the ring of nodes that share the text, or
+	     * NULL when the text belongs to this node alone. */
+	char tiny[sizeof(struct filestruct *)];
+	    /* The text itself, when it is short enough to fit here. */
+    } store;
+	/* Where the node keeps either its twin or its text. */
     struct filestruct *next;
 	/* Next node. */
     struct filestruct *prev;
 	/* Previous node. */
+    ssize_t lineno;
+	/* The number of this line, as it was at the given epoch. */
+    unsigned int epoch;
+	/* The epoch of the buffer at which lineno was last right, or zero
+	 * when lineno needs no adjusting. */
+    unsigned int length;
+	/* The length of the text in bytes, or NOT_KNOWN. */
+    unsigned int width;
+	/* The width of the text in columns, or NOT_KNOWN. */
 #ifndef DISABLE_COLOR
-    short *multidata;
-	/* Array of which multi-line regexes apply to this line. */
+    unsigned int multidata;
+	/* How each of the first MAX_CACHED_MULTIS multiline regexes applies
+	 * to this line, in MULTI_BITS bits per regex; zero when unknown. */
+#endif
+#ifndef NANO_TINY
+    unsigned int charmap;
+	/* Which bytes occur in this line, as bits from CHARMAP_BIT();
+	 * zero when this has not been determined yet. */
+    unsigned int wordmap;
+	/* Which bytes occur at the start of a word in this line. */
 #endif
 } filestruct;
 
+typedef struct nodeslab {
+    struct nodeslab *prev;
+	/* The previous slab in the list of slabs with free nodes. */
+    struct nodeslab *next;
+	/* The next slab in that list. */
+    filestruct *spare;
+	/* The free nodes of this slab, linked through their next field. */
+    size_t used;
+	/* How many nodes of this slab are in use. */
+    size_t fresh;
+	/* How many nodes at the end of this slab were never handed out. */
+} nodeslab;
+
+#ifdef USING_MMAP
+typedef struct mapstruct {
+    char *start;
+	/* Where the mapping begins in memory. */
+    size_t size;
+	/* The number of bytes that are mapped. */
+    size_t users;
+	/* How many lines still have their text in the mapping. */
+    struct mapstruct *next;
+	/* The next file mapping. */
+} mapstruct;
+#endif
+
+typedef struct shiftstruct {
+    ssize_t from;
+	/* The first line number that was affected. */
+    ssize_t delta;
+	/* By how much the lines from there on moved. */
+} shiftstruct;
+
 typedef struct partition {
     filestruct *fileage;
 	/* The top line of this portion of the file. */
@@ -294,6 +368,29 @@ typedef struct partition {
 	 * the file. */
 } partition;
 
+typedef struct rangestruct {
+    filestruct *top;
+	/* The line on which the range begins. */
+    size_t top_x;
+	/* Where in that line the range begins. */
+    filestruct *bot;
+	/* The line on which the range ends. */
+    size_t bot_x;
+	/* Where in that line the range ends. */
+} rangestruct;
+
+typedef struct screenrow {
+    filestruct *line;
+	/* The line whose text is shown on this row of the edit window,
+	 * or NULL when the row is blank. */
+    size_t start;
+	/* The byte index in line->data of the first character on this row. */
+    size_t end;
+	/* The byte index just past the last character that fits on this row. */
+    size_t leftedge;
+	/* The column of the line that is shown at the left edge of the row. */
+} screenrow;
+
 #ifndef NANO_TINY
 typedef struct undo_group {
     ssize_t top_line;
@@ -346,6 +443,15 @@ typedef struct poshiststruct {
 } poshiststruct;
 #endif
 
+#ifndef NANO_TINY
+typedef struct anchorstruct {
+    filestruct *line;
+	/* The line of a remembered position, or NULL when it is gone. */
+    size_t x;
+	/* The byte offset of the position in that line. */
+} anchorstruct;
+#endif
+
 typedef struct openfilestruct {
     char *filename;
 	/* The file's name. */
@@ -357,6 +463,19 @@ typedef struct openfilestruct {
 	/* The current top of the edit window for this file. */
     filestruct *current;
 	/* The current line for this file. */
+    filestruct **lineindex;
+	/* Every LINE_STRIDE-th line of the file, starting with line 1. */
+    size_t index_size;
+	/* The number of slots allocated for lineindex. */
+    size_t index_count;
+	/* The number of leading slots of lineindex that were filled. */
+    shiftstruct *shifts;
+	/* The line shifts that were not yet applied to all lines. */
+    size_t shift_base;
+	/* The epoch of the first of those shifts; each shift begins
+	 * a new epoch. */
+    size_t shift_count;
+	/* The number of those shifts. */
     size_t totsize;
 	/* The file's total number of characters. */
     size_t firstcolumn;
@@ -391,6 +510,15 @@ typedef struct openfilestruct {
 	/* The type of the last action the user performed. */
     char *lock_filename;
 	/* The path of the lockfile, if we created one. */
+    anchorstruct *anchors;
+	/* The ring of positions that jumps and searches left from. */
+    size_t anchor_first;
+	/* The index in anchors of the oldest remembered position. */
+    size_t anchor_count;
+	/* The number of positions in the ring. */
+    size_t anchor_here;
+	/* How far along the ring the user has gone back; equal to
+	 * anchor_count when at the present. */
 #endif
 #ifndef DISABLE_COLOR
     syntaxtype *syntax;
@@ -522,7 +650,10 @@ enum
     NO_PAUSES,
     JUMP_INSIDE,
     JUMP_CENTER,
-    JUMP_NOCOLOR
+    JUMP_NOCOLOR,
+    JUMP_BUFFER,
+    JUMP_TYPEAHEAD,
+    JUMP_ALLBUFFERS
 };
 
 /* Flags for the menus in which a given function should be present. */
@@ -607,6 +738,33 @@ enum
  * counting the blank lines at their ends. */
 #define MAX_SEARCH_HISTORY 100
 
+/* The maximum number of positions in the jump history of a buffer. */
+#define MAX_ANCHORS 64
+
+/* The size of a slab of line nodes, which is also its alignment, so that
+ * the slab of a node can be found from the node's address.  A power of two,
+ * and big, because each slab costs a page or so for its alignment. */
+#define SLAB_SIZE 1048576
+
+/* The number of line nodes in a slab. */
+#define NODES_PER_SLAB ((SLAB_SIZE - sizeof(nodeslab)) / sizeof(filestruct))
+
+/* The distance in lines between two entries in the line index of a
+ * buffer, and thus the longest walk needed to find a line by number. */
+#define LINE_STRIDE 64
+
+/* The number of line shifts that are kept before all lines of a buffer
+ * get renumbered in one go. */
+#define MAX_SHIFTS 1024
+
+/* The value of a cached line length or width that must be recomputed;
+ * a length or width that doesn't fit below it is simply not cached. */
+#define NOT_KNOWN ((unsigned int)-1)
+
+/* The highest epoch a line can carry; a buffer that gets there starts
+ * counting its epochs anew. */
+#define MAX_EPOCH ((unsigned int)-1 - MAX_SHIFTS)
+
 /* The maximum number of bytes buffered at one time. */
 #define MAX_BUF_SIZE 128
 
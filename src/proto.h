@@ -91,6 +91,7 @@ extern WINDOW *topwin;
 extern WINDOW *edit;
 extern WINDOW *bottomwin;
 extern int editwinrows;
+extern screenrow *screenmap;
 
 extern filestruct *cutbuffer;
 extern filestruct *cutbottom;
@@ -122,6 +123,8 @@ extern char *quoteerr;
 extern char *word_chars;
 
 extern char *jump_mode_label_chars;
+extern ssize_t jump_mode_radius;
+extern ssize_t jump_mode_needle;
 
 extern char *answer;
 
@@ -183,6 +186,8 @@ char *do_browse_from(const char *inpath);
 void read_the_list(const char *path, DIR *dir);
 functionptrtype parse_browser_input(int *kbinput);
 void browser_refresh(void);
+const char *browser_shown_name(size_t n, int *row, int *col);
+void browser_select_shown(size_t n);
 void browser_select_dirname(const char *needle);
 void do_filesearch(void);
 void do_fileresearch(void);
@@ -199,6 +204,7 @@ bool using_utf8(void);
 char *addstrings(char* str1, size_t len1, char* str2, size_t len2);
 bool is_byte(int c);
 bool is_alpha_mbchar(const char *c);
+bool is_alnum_mbchar(const char *c);
 bool is_blank_mbchar(const char *c);
 bool is_ascii_cntrl_char(int c);
 bool is_cntrl_mbchar(const char *c);
@@ -243,7 +249,8 @@ void set_colorpairs(void);
 void color_init(void);
 void color_update(void);
 void check_the_multis(filestruct *line);
-void alloc_multidata_if_needed(filestruct *fileptr);
+short multi_state(const filestruct *line, int id);
+void set_multi_state(filestruct *line, int id, short state);
 void precalc_multicolorinfo(void);
 #endif
 
@@ -275,6 +282,7 @@ void prepare_for_display(void);
 #ifdef ENABLE_MULTIBUFFER
 void switch_to_prev_buffer_void(void);
 void switch_to_next_buffer_void(void);
+void redecorate_after_switch(void);
 bool close_buffer(void);
 #endif
 void read_file(FILE *f, int fd, const char *filename, bool undoable,
@@ -295,7 +303,8 @@ int write_lockfile(const char *lockfilename, const char *origfilename, bool modi
 #endif
 int copy_file(FILE *inn, FILE *out, bool close_out);
 bool write_file(const char *name, FILE *f_open, bool tmp,
-	kind_of_writing_type method, bool nonamechange);
+	kind_of_writing_type method, bool nonamechange,
+	const rangestruct *range);
 #ifndef NANO_TINY
 bool write_marked_file(const char *name, FILE *f_open, bool tmp,
 	kind_of_writing_type method);
@@ -386,18 +395,43 @@ void do_scroll_down(void);
 #endif
 void do_left(void);
 void do_right(void);
+#ifndef NANO_TINY
+void push_anchor(filestruct *line, size_t x);
+void move_anchors(filestruct *line, size_t from_x, filestruct *to,
+	ssize_t shift);
+void gather_anchors(filestruct *top, size_t top_x, filestruct *bot,
+	size_t bot_x);
+void go_to_anchor(size_t index);
+void do_anchor_back(void);
+void do_anchor_forward(void);
+#endif
 
 char do_char_prompt(const char *message);
 void do_jump_void(void);
+#ifndef NANO_TINY
+void do_jump_select_void(void);
+#endif
 
 /* Most functions in nano.c. */
+filestruct *take_node(void);
+void give_back_node(filestruct *node);
 filestruct *make_new_node(filestruct *prevnode);
+#ifdef USING_MMAP
+void adopt_mapping(char *start, size_t size, size_t users);
+#endif
+void set_text(filestruct *line, const char *text);
 void splice_node(filestruct *afterthis, filestruct *newnode);
 void unlink_node(filestruct *fileptr);
+void unshare_line(filestruct *line);
+void release_text(filestruct *line);
 void delete_node(filestruct *fileptr);
-filestruct *copy_filestruct(const filestruct *src);
+filestruct *copy_filestruct(filestruct *src);
 void free_filestruct(filestruct *src);
+void store_in_index(filestruct *line, size_t slot);
+void forget_index_from(ssize_t lineno);
+filestruct *closest_indexed_line(ssize_t lineno);
 void renumber(filestruct *fileptr);
+void renumber_span(filestruct *first, filestruct *last);
 partition *partition_filestruct(filestruct *top, size_t top_x,
 	filestruct *bot, size_t bot_x);
 void unpartition_filestruct(partition **p);
@@ -481,6 +515,8 @@ void do_rcfiles(void);
 #endif /* ENABLE_NANORC */
 
 /* Most functions in search.c. */
+bool regexp_init(const char *regexp);
+void regexp_cleanup(void);
 void not_found_msg(const char *str);
 void search_replace_abort(void);
 int findnextstr(const char *needle, bool whole_word_only, bool have_region,
@@ -499,6 +535,7 @@ void goto_line_posx(ssize_t line, size_t pos_x);
 void do_gotolinecolumn(ssize_t line, ssize_t column, bool use_answer,
 	bool interactive);
 void do_gotolinecolumn_void(void);
+void center_the_target(void);
 #ifndef NANO_TINY
 void do_find_bracket(void);
 #ifdef ENABLE_TABCOMP
@@ -610,17 +647,26 @@ size_t actual_x(const char *s, size_t column);
 size_t strnlenpt(const char *s, size_t maxlen);
 size_t strlenpt(const char *s);
 void new_magicline(void);
-#if !defined(NANO_TINY) || defined(ENABLE_HELP)
+#ifdef ENABLE_HELP
 void remove_magicline(void);
 #endif
 #ifndef NANO_TINY
 void mark_order(const filestruct **top, size_t *top_x, const filestruct
 	**bot, size_t *bot_x, bool *right_side_up);
+void mark_range(rangestruct *range);
 #endif
 size_t get_totsize(const filestruct *begin, const filestruct *end);
-#ifndef NANO_TINY
 filestruct *fsfromline(ssize_t lineno);
-#endif
+#ifndef NANO_TINY
+void index_line(filestruct *line);
+bool line_may_contain(filestruct *line, unsigned int mask,
+	bool word_start);
+#endif
+void invalidate_line(filestruct *line);
+size_t line_length(filestruct *line);
+size_t line_width(filestruct *line);
+ssize_t line_number(filestruct *line);
+ssize_t line_number_in(openfilestruct *buffer, filestruct *line);
 #ifdef DEBUG
 void dump_filestruct(const filestruct *inptr);
 void dump_filestruct_reverse(void);
@@ -656,6 +702,9 @@ void statusline(message_type importance, const char *msg, ...);
 void bottombars(int menu);
 void onekey(const char *keystroke, const char *desc, int length);
 void place_the_cursor(bool forreal);
+void map_row(int row, filestruct *fileptr, size_t leftedge);
+void unmap_row(int row);
+const screenrow *mapped_row(int row);
 void edit_draw(filestruct *fileptr, const char *converted,
 	int line, size_t from_col);
 int update_line(filestruct *fileptr, size_t index);
@@ -111,9 +111,16 @@ static const rcoption rcopts[] = {
     {"wordbounds", WORD_BOUNDS},
     {"wordchars", 0},
     {"jump-mode-inside", JUMP_INSIDE},
+    {"jump-mode-needle", 0},
+    {"jump-mode-type-ahead", JUMP_TYPEAHEAD},
     {"jump-mode-center", JUMP_CENTER},
     {"jump-mode-no-color", JUMP_NOCOLOR},
     {"jump-mode-label-chars", 0},
+    {"jump-mode-whole-buffer", JUMP_BUFFER},
+#ifdef ENABLE_MULTIBUFFER
+    {"jump-mode-all-buffers", JUMP_ALLBUFFERS},
+#endif
+    {"jump-mode-radius", 0},
 #endif
 #ifndef DISABLE_COLOR
     {"titlecolor", 0},
@@ -1231,9 +1238,37 @@ void parse_rcfile(FILE *rcstream, bool syntax_only)
 	    }
 	    free(option);
 	} else
-	if (strcasecmp(rcopts[i].name, "jump-mode-label-chars") == 0)
-	    jump_mode_label_chars = option;
-	else
+	if (strcasecmp(rcopts[i].name, "jump-mode-label-chars") == 0) {
+	    const char *ch = option;
+
+	    /* The labels are typed, so each character must be a distinct,
+	     * visible one; and prefix codes need at least two of them. */
+	    while (*ch > ' ' && *ch <= '~' && strchr(ch + 1, *ch) == NULL)
+		ch++;
+	    if (*ch != '\0' || strlen(option) < 2) {
+		rcfile_error(N_("Label characters must be two or more distinct "
+				"visible ASCII characters"));
+		free(option);
+	    } else
+		jump_mode_label_chars = option;
+	} else
+	if (strcasecmp(rcopts[i].name, "jump-mode-radius") == 0) {
+	    if (!parse_num(option, &jump_mode_radius) || jump_mode_radius < 0) {
+		rcfile_error(N_("Requested jump radius \"%s\" is invalid"),
+				option);
+		jump_mode_radius = 0;
+	    }
+	    free(option);
+	} else
+	if (strcasecmp(rcopts[i].name, "jump-mode-needle") == 0) {
+	    if (!parse_num(option, &jump_mode_needle) ||
+			jump_mode_needle < 1 || jump_mode_needle > 3) {
+		rcfile_error(N_("Requested jump needle length \"%s\" is invalid"),
+				option);
+		jump_mode_needle = 1;
+	    }
+	    free(option);
+	} else
 	    assert(FALSE);
     }
 
@@ -206,7 +206,7 @@ int search_init(bool replacing, bool use_answer)
 	backupstring = mallocstrcpy(backupstring, answer);
 	return -2;	/* Call the opposite search function. */
     } else if (func == do_gotolinecolumn_void) {
-	do_gotolinecolumn(openfile->current->lineno,
+	do_gotolinecolumn(line_number(openfile->current),
 			openfile->placewewant + 1, TRUE, TRUE);
 	return 3;
     }
@@ -456,6 +456,10 @@ void go_looking(void)
     if (didfind == 1 && openfile->current == was_current &&
 		openfile->current_x == was_current_x)
 	statusbar(_("This is the only occurrence"));
+#ifndef NANO_TINY
+    else if (didfind == 1)
+	push_anchor(was_current, was_current_x);
+#endif
 
 #ifdef DEBUG
     statusline(HUSH, "Took: %.2f", (double)(clock() - start) / CLOCKS_PER_SEC);
@@ -600,8 +604,9 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 
 #ifndef NANO_TINY
 	/* An occurrence outside of the marked region means we're done. */
-	if (mark_was_set && (openfile->current->lineno > bot->lineno ||
-				openfile->current->lineno < top->lineno ||
+	if (mark_was_set &&
+				(line_number(openfile->current) > line_number(bot) ||
+				line_number(openfile->current) < line_number(top) ||
 				(openfile->current == bot &&
 				openfile->current_x + match_len > bot_x) ||
 				(openfile->current == top &&
@@ -695,8 +700,9 @@ ssize_t do_replace_loop(const char *needle, bool whole_word_only,
 
 	    /* Update the file size, and put the changed line into place. */
 	    openfile->totsize += mbstrlen(copy) - mbstrlen(openfile->current->data);
-	    free(openfile->current->data);
+	    release_text(openfile->current);
 	    openfile->current->data = copy;
+	    invalidate_line(openfile->current);
 
 	    if (!replaceall) {
 #ifndef DISABLE_COLOR
@@ -860,7 +866,7 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool use_answer,
 	}
     } else {
 	if (line == 0)
-	    line = openfile->current->lineno;
+	    line = line_number(openfile->current);
 
 	if (column == 0)
 	    column = openfile->placewewant + 1;
@@ -868,18 +874,22 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool use_answer,
 
     /* Take a negative line number to mean: from the end of the file. */
     if (line < 0)
-	line = openfile->filebot->lineno + line + 1;
+	line = line_number(openfile->filebot) + line + 1;
     if (line < 1)
 	line = 1;
 
-    /* Iterate to the requested line. */
-    for (openfile->current = openfile->fileage; line > 1 &&
-		openfile->current != openfile->filebot; line--)
-	openfile->current = openfile->current->next;
+#ifndef NANO_TINY
+    push_anchor(openfile->current, openfile->current_x);
+#endif
+
+    /* Go to the requested line, or to the last one when beyond it. */
+    if (line > line_number(openfile->filebot))
+	line = line_number(openfile->filebot);
+    openfile->current = fsfromline(line);
 
     /* Take a negative column number to mean: from the end of the line. */
     if (column < 0)
-	column = strlenpt(openfile->current->data) + column + 2;
+	column = line_width(openfile->current) + column + 2;
     if (column < 1)
 	column = 1;
 
@@ -889,44 +899,48 @@ void do_gotolinecolumn(ssize_t line, ssize_t column, bool use_answer,
 
 #ifndef NANO_TINY
     if (ISSET(SOFTWRAP) && openfile->placewewant / editwincols >
-			strlenpt(openfile->current->data) / editwincols)
-	openfile->placewewant = strlenpt(openfile->current->data);
+			line_width(openfile->current) / editwincols)
+	openfile->placewewant = line_width(openfile->current);
 #endif
 
     /* When the position was manually given, center the target line. */
     if (interactive) {
 	adjust_viewport(CENTERING);
 	refresh_needed = TRUE;
-    } else {
-	int rows_from_tail;
+    } else
+	center_the_target();
+}
+
+/* Scroll the screen so that the current line is in the middle of it, or,
+ * when that line is close to the tail of the file, so that the last line
+ * or chunk is on the bottom line of the screen. */
+void center_the_target(void)
+{
+    int rows_from_tail;
 
 #ifndef NANO_TINY
-	if (ISSET(SOFTWRAP)) {
-	    filestruct *line = openfile->current;
-	    size_t leftedge = (xplustabs() / editwincols) * editwincols;
+    if (ISSET(SOFTWRAP)) {
+	filestruct *line = openfile->current;
+	size_t leftedge = (xplustabs() / editwincols) * editwincols;
 
-	    rows_from_tail = (editwinrows / 2) -
-			go_forward_chunks(editwinrows / 2, &line, &leftedge);
-	} else
+	rows_from_tail = (editwinrows / 2) -
+		go_forward_chunks(editwinrows / 2, &line, &leftedge);
+    } else
 #endif
-	    rows_from_tail = openfile->filebot->lineno -
-				openfile->current->lineno;
-
-	/* If the target line is close to the tail of the file, put the last
-	 * line or chunk on the bottom line of the screen; otherwise, just
-	 * center the target line. */
-	if (rows_from_tail < editwinrows / 2) {
-	    openfile->current_y = editwinrows - 1 - rows_from_tail;
-	    adjust_viewport(STATIONARY);
-	} else
-	    adjust_viewport(CENTERING);
-    }
+	rows_from_tail = line_number(openfile->filebot) -
+				line_number(openfile->current);
+
+    if (rows_from_tail < editwinrows / 2) {
+	openfile->current_y = editwinrows - 1 - rows_from_tail;
+	adjust_viewport(STATIONARY);
+    } else
+	adjust_viewport(CENTERING);
 }
 
 /* Go to the specified line and column, asking for them beforehand. */
 void do_gotolinecolumn_void(void)
 {
-    do_gotolinecolumn(openfile->current->lineno,
+    do_gotolinecolumn(line_number(openfile->current),
 	openfile->placewewant + 1, FALSE, TRUE);
 }
 
@@ -939,9 +953,15 @@ bool find_bracket_match(bool reverse, const char *bracket_set)
 {
     filestruct *fileptr = openfile->current;
     const char *rev_start = NULL, *found = NULL;
+    unsigned int wanted = 0;
+	/* The line-index bits of the bytes in bracket_set. */
+    const char *byte;
 
     assert(mbstrlen(bracket_set) == 2);
 
+    for (byte = bracket_set; *byte != '\0'; byte++)
+	wanted |= CHARMAP_BIT(*byte);
+
     /* rev_start might end up 1 character before the start or after the
      * end of the line.  This won't be a problem because we'll skip over
      * it below in that case, and rev_start will be properly set when
@@ -966,10 +986,14 @@ bool find_bracket_match(bool reverse, const char *bracket_set)
 	if (found)
 	    break;
 
-	if (reverse)
-	    fileptr = fileptr->prev;
-	else
-	    fileptr = fileptr->next;
+	/* Step to the previous or next line, passing over the lines
+	 * whose index says that they contain neither bracket. */
+	do {
+	    if (reverse)
+		fileptr = fileptr->prev;
+	    else
+		fileptr = fileptr->next;
+	} while (fileptr != NULL && !line_may_contain(fileptr, wanted, FALSE));
 
 	/* If we've reached the start or end of the buffer, get out. */
 	if (fileptr == NULL)
@@ -1078,6 +1102,7 @@ void do_find_bracket(void)
 	    /* If count is zero, we've found a matching bracket.  Update
 	     * the screen and get out. */
 	    if (count == 0) {
+		push_anchor(current_save, current_x_save);
 		focusing = FALSE;
 		edit_redraw(current_save);
 		break;
@@ -103,8 +103,8 @@ void do_deletion(undo_type action)
 	/* We're in the middle of a line: delete the current character. */
 	int char_len = parse_mbchar(openfile->current->data +
 					openfile->current_x, NULL, NULL);
-	size_t line_len = strlen(openfile->current->data +
-					openfile->current_x);
+	size_t line_len = line_length(openfile->current) -
+					openfile->current_x;
 
 	assert(openfile->current_x < strlen(openfile->current->data));
 
@@ -112,21 +112,28 @@ void do_deletion(undo_type action)
 	update_undo(action);
 
 	if (ISSET(SOFTWRAP))
-	    orig_rows = strlenpt(openfile->current->data) / editwincols;
+	    orig_rows = line_width(openfile->current) / editwincols;
 #endif
 
 	/* Move the remainder of the line "in", over the current character. */
+	unshare_line(openfile->current);
 	charmove(&openfile->current->data[openfile->current_x],
 		&openfile->current->data[openfile->current_x + char_len],
 		line_len - char_len + 1);
 	null_at(&openfile->current->data, openfile->current_x +
 		line_len - char_len);
+	invalidate_line(openfile->current);
+	if (openfile->current_x + line_len - char_len < NOT_KNOWN)
+	    openfile->current->length = openfile->current_x + line_len - char_len;
 
 #ifndef NANO_TINY
 	/* Adjust the mark if it is after the cursor on the current line. */
 	if (openfile->mark_set && openfile->mark_begin == openfile->current &&
 				openfile->mark_begin_x > openfile->current_x)
 	    openfile->mark_begin_x -= char_len;
+
+	gather_anchors(openfile->current, openfile->current_x,
+			openfile->current, openfile->current_x + char_len);
 #endif
 	/* Adjust the file size. */
 	openfile->totsize--;
@@ -151,9 +158,11 @@ void do_deletion(undo_type action)
 	add_undo(action);
 #endif
 	/* Add the contents of the next line to those of the current one. */
+	unshare_line(openfile->current);
 	openfile->current->data = charealloc(openfile->current->data,
 		strlen(openfile->current->data) + strlen(joining->data) + 1);
 	strcat(openfile->current->data, joining->data);
+	invalidate_line(openfile->current);
 
 	/* Adjust the file size. */
 	openfile->totsize--;
@@ -167,9 +176,11 @@ void do_deletion(undo_type action)
 	    openfile->mark_begin = openfile->current;
 	    openfile->mark_begin_x += openfile->current_x;
 	}
+
+	move_anchors(joining, 0, openfile->current, openfile->current_x);
 #endif
 	unlink_node(joining);
-	renumber(openfile->current);
+	renumber_span(openfile->current, openfile->current);
 
 	/* Two lines were joined, so we need to refresh the screen. */
 	refresh_needed = TRUE;
@@ -181,7 +192,7 @@ void do_deletion(undo_type action)
     /* If the number of screen rows that a softwrapped line occupies
      * has changed, we need a full refresh. */
     if (ISSET(SOFTWRAP) && refresh_needed == FALSE &&
-		strlenpt(openfile->current->data) / editwincols != orig_rows)
+		line_width(openfile->current) / editwincols != orig_rows)
 	refresh_needed = TRUE;
 #endif
 
@@ -352,10 +363,12 @@ void do_indent(ssize_t cols)
 	if (!unindent) {
 	    /* If we're indenting, add the characters in line_indent to
 	     * the beginning of the non-whitespace text of this line. */
+	    unshare_line(f);
 	    f->data = charealloc(f->data, line_len + line_indent_len + 1);
 	    charmove(&f->data[indent_len + line_indent_len],
 		&f->data[indent_len], line_len - indent_len + 1);
 	    strncpy(f->data + indent_len, line_indent, line_indent_len);
+	    invalidate_line(f);
 	    openfile->totsize += line_indent_len;
 
 	    /* Keep track of the change in the current line. */
@@ -385,9 +398,11 @@ void do_indent(ssize_t cols)
 		/* If we're unindenting, and there's at least cols
 		 * columns' worth of indentation at the beginning of the
 		 * non-whitespace text of this line, remove it. */
+		unshare_line(f);
 		charmove(&f->data[indent_new], &f->data[indent_len],
 			line_len - indent_shift - indent_new + 1);
 		null_at(&f->data, line_len - indent_shift + 1);
+		invalidate_line(f);
 		openfile->totsize -= indent_shift;
 
 		/* Keep track of the change in the current line. */
@@ -517,7 +532,7 @@ void do_comment()
     for (f = top; f != bot->next; f = f->next) {
 	/* Comment/uncomment a line, and add undo data when line changed. */
 	if (comment_line(action, f, comment_seq))
-	    update_comment_undo(f->lineno);
+	    update_comment_undo(line_number(f));
     }
 
     set_modified();
@@ -544,12 +559,14 @@ bool comment_line(undo_type action, filestruct *f, const char *comment_seq)
     if (action == COMMENT) {
 	/* Make room for the comment sequence(s), move the text right and
 	 * copy them in. */
+	unshare_line(f);
 	f->data = charealloc(f->data, line_len + pre_len + post_len + 1);
 	charmove(&f->data[pre_len], f->data, line_len);
 	charmove(f->data, comment_seq, pre_len);
 	if (post_len)
 	    charmove(&f->data[pre_len + line_len], post_seq, post_len);
 	f->data[pre_len + line_len + post_len] = '\0';
+	invalidate_line(f);
 
 	openfile->totsize += pre_len + post_len;
 
@@ -572,9 +589,11 @@ bool comment_line(undo_type action, filestruct *f, const char *comment_seq)
 	    return TRUE;
 
 	/* Erase the comment prefix by moving the non-comment part. */
+	unshare_line(f);
 	charmove(f->data, &f->data[pre_len], line_len - pre_len);
 	/* Truncate the postfix if there was one. */
 	f->data[line_len - pre_len - post_len] = '\0';
+	invalidate_line(f);
 
 	openfile->totsize -= pre_len + post_len;
 
@@ -611,7 +630,7 @@ void handle_comment_action(undo *u, bool undoing, bool add_comment)
     while (group) {
 	filestruct *f = fsfromline(group->top_line);
 
-	while (f && f->lineno <= group->bottom_line) {
+	while (f && line_number(f) <= group->bottom_line) {
 	    comment_line(undoing ^ add_comment ?
 				COMMENT : UNCOMMENT, f, u->strdata);
 	    f = f->next;
@@ -707,8 +726,9 @@ void do_undo(void)
 	data = charalloc(strlen(f->data) - strlen(u->strdata) + 1);
 	strncpy(data, f->data, u->begin);
 	strcpy(&data[u->begin], &f->data[u->begin + strlen(u->strdata)]);
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	goto_line_posx(u->lineno, u->begin);
 	break;
     case BACK:
@@ -718,8 +738,9 @@ void do_undo(void)
 	strncpy(data, f->data, u->begin);
 	strcpy(&data[u->begin], u->strdata);
 	strcpy(&data[u->begin + strlen(u->strdata)], &f->data[u->begin]);
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	goto_line_posx(u->mark_begin_lineno, u->mark_begin_x);
 	break;
 #ifndef DISABLE_WRAPPING
@@ -741,16 +762,18 @@ void do_undo(void)
 	 * and the nonewlines flag isn't set, do not re-add a newline that
 	 * wasn't actually deleted; just position the cursor. */
 	if (u->xflags == WAS_FINAL_BACKSPACE && !ISSET(NO_NEWLINES)) {
-	    goto_line_posx(openfile->filebot->lineno, 0);
+	    goto_line_posx(line_number(openfile->filebot), 0);
 	    break;
 	}
 	t = make_new_node(f);
 	t->data = mallocstrcpy(NULL, u->strdata);
 	data = mallocstrncpy(NULL, f->data, u->mark_begin_x + 1);
 	data[u->mark_begin_x] = '\0';
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	splice_node(f, t);
+	renumber_span(f, t);
 	goto_line_posx(u->lineno, u->begin);
 	break;
     case CUT_EOF:
@@ -773,10 +796,14 @@ void do_undo(void)
 	undidmsg = _("line break");
 	from_x = (u->begin == 0) ? 0 : u->mark_begin_x;
 	to_x = (u->begin == 0) ? u->mark_begin_x : u->begin;
+	move_anchors(f->next, 0, f, strlen(f->data));
+	unshare_line(f);
 	f->data = charealloc(f->data, strlen(f->data) +
 				strlen(&u->strdata[from_x]) + 1);
 	strcat(f->data, &u->strdata[from_x]);
+	invalidate_line(f);
 	unlink_node(f->next);
+	renumber_span(f, f);
 	goto_line_posx(u->lineno, to_x);
 	break;
 #ifdef ENABLE_COMMENT
@@ -810,9 +837,11 @@ void do_undo(void)
     case REPLACE:
 	undidmsg = _("text replace");
 	goto_line_posx(u->lineno, u->begin);
+	unshare_line(f);
 	data = u->strdata;
 	u->strdata = f->data;
 	f->data = data;
+	invalidate_line(f);
 	break;
     default:
 	statusline(ALERT, _("Internal error: unknown type.  "
@@ -823,8 +852,6 @@ void do_undo(void)
     if (undidmsg && !pletion_line)
 	statusline(HUSH, _("Undid action (%s)"), undidmsg);
 
-    renumber(f);
-
     openfile->current_undo = openfile->current_undo->next;
     openfile->last_action = OTHER;
     openfile->mark_set = FALSE;
@@ -872,8 +899,9 @@ void do_redo(void)
 	strncpy(data, f->data, u->begin);
 	strcpy(&data[u->begin], u->strdata);
 	strcpy(&data[u->begin + strlen(u->strdata)], &f->data[u->begin]);
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	goto_line_posx(u->mark_begin_lineno, u->mark_begin_x);
 	break;
     case BACK:
@@ -882,8 +910,9 @@ void do_redo(void)
 	data = charalloc(strlen(f->data) + strlen(u->strdata) + 1);
 	strncpy(data, f->data, u->begin);
 	strcpy(&data[u->begin], &f->data[u->begin + strlen(u->strdata)]);
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	goto_line_posx(u->lineno, u->begin);
 	break;
     case ENTER:
@@ -892,10 +921,11 @@ void do_redo(void)
 	shoveline->data = mallocstrcpy(NULL, u->strdata);
 	data = mallocstrncpy(NULL, f->data, u->begin + 1);
 	data[u->begin] = '\0';
-	free(f->data);
+	release_text(f);
 	f->data = data;
+	invalidate_line(f);
 	splice_node(f, shoveline);
-	renumber(shoveline);
+	renumber_span(shoveline, shoveline);
 	goto_line_posx(u->lineno + 1, u->mark_begin_x);
 	break;
 #ifndef DISABLE_WRAPPING
@@ -925,10 +955,13 @@ void do_redo(void)
 	    goto_line_posx(u->mark_begin_lineno, u->mark_begin_x);
 	    break;
 	}
+	move_anchors(f->next, 0, f, strlen(f->data));
+	unshare_line(f);
 	f->data = charealloc(f->data, strlen(f->data) + strlen(u->strdata) + 1);
 	strcat(f->data, u->strdata);
+	invalidate_line(f);
 	unlink_node(f->next);
-	renumber(f);
+	renumber_span(f, f);
 	goto_line_posx(u->mark_begin_lineno, u->mark_begin_x);
 	break;
     case CUT_EOF:
@@ -942,9 +975,11 @@ void do_redo(void)
 	break;
     case REPLACE:
 	redidmsg = _("text replace");
+	unshare_line(f);
 	data = u->strdata;
 	u->strdata = f->data;
 	f->data = data;
+	invalidate_line(f);
 	goto_line_posx(u->lineno, u->begin);
 	break;
     case INSERT:
@@ -1001,6 +1036,10 @@ void do_enter(void)
 	else if (extra == openfile->current_x)
 	    allblanks = TRUE;
     }
+
+    /* Remembered positions after the cursor move along to the new line. */
+    move_anchors(openfile->current, openfile->current_x + 1, newnode,
+			extra - openfile->current_x);
 #endif
     newnode->data = charalloc(strlen(openfile->current->data +
 					openfile->current_x) + extra + 1);
@@ -1018,7 +1057,9 @@ void do_enter(void)
     }
 #endif
 
+    unshare_line(openfile->current);
     null_at(&openfile->current->data, openfile->current_x);
+    invalidate_line(openfile->current);
 
 #ifndef NANO_TINY
     add_undo(ENTER);
@@ -1032,7 +1073,7 @@ void do_enter(void)
 #endif
 
     splice_node(openfile->current, newnode);
-    renumber(newnode);
+    renumber_span(newnode, newnode);
 
     openfile->current = newnode;
     openfile->current_x = extra;
@@ -1180,7 +1221,7 @@ void add_undo(undo_type action)
 
     /* When doing contiguous adds or contiguous cuts -- which means: with
      * no cursor movement in between -- don't add a new undo item. */
-    if (u && u->mark_begin_lineno == openfile->current->lineno && action == openfile->last_action &&
+    if (u && u->mark_begin_lineno == line_number(openfile->current) && action == openfile->last_action &&
 	((action == ADD && u->type == ADD && u->mark_begin_x == openfile->current_x) ||
 	(action == CUT && u->type == CUT && u->xflags < MARK_WAS_SET && keeping_cutbuffer())))
 	return;
@@ -1212,9 +1253,9 @@ void add_undo(undo_type action)
     u->strdata = NULL;
     u->cutbuffer = NULL;
     u->cutbottom = NULL;
-    u->lineno = openfile->current->lineno;
+    u->lineno = line_number(openfile->current);
     u->begin = openfile->current_x;
-    u->mark_begin_lineno = openfile->current->lineno;
+    u->mark_begin_lineno = line_number(openfile->current);
     u->mark_begin_x = openfile->current_x;
     u->wassize = openfile->totsize;
     u->xflags = 0;
@@ -1247,7 +1288,7 @@ void add_undo(undo_type action)
     case JOIN:
 	if (openfile->current->next) {
 	    if (u->type == BACK) {
-		u->lineno = openfile->current->next->lineno;
+		u->lineno = line_number(openfile->current->next);
 		u->begin = 0;
 	    }
 	    u->strdata = mallocstrcpy(NULL, openfile->current->next->data);
@@ -1272,7 +1313,7 @@ void add_undo(undo_type action)
     case CUT:
 	cutbuffer_reset();
 	if (openfile->mark_set) {
-	    u->mark_begin_lineno = openfile->mark_begin->lineno;
+	    u->mark_begin_lineno = line_number(openfile->mark_begin);
 	    u->mark_begin_x = openfile->mark_begin_x;
 	    u->xflags = MARK_WAS_SET;
 	} else if (!ISSET(CUT_TO_END)) {
@@ -1340,7 +1381,7 @@ void update_undo(undo_type action)
 
 #ifdef DEBUG
 fprintf(stderr, "  >> Updating... action = %d, openfile->last_action = %d, openfile->current->lineno = %ld",
-		action, openfile->last_action, (long)openfile->current->lineno);
+		action, openfile->last_action, (long)line_number(openfile->current));
 	if (openfile->current_undo)
 	    fprintf(stderr, ", openfile->current_undo->lineno = %ld\n", (long)openfile->current_undo->lineno);
 	else
@@ -1351,7 +1392,8 @@ fprintf(stderr, "  >> Updating... action = %d, openfile->last_action = %d, openf
      * that we should be using. */
     if (action != openfile->last_action ||
 		(action != ENTER && action != CUT && action != INSERT &&
-		openfile->current->lineno != openfile->current_undo->lineno)) {
+		line_number(openfile->current) !=
+				openfile->current_undo->lineno)) {
 	add_undo(action);
 	return;
     }
@@ -1373,7 +1415,7 @@ fprintf(stderr, "  >> Updating... action = %d, openfile->last_action = %d, openf
 #ifdef DEBUG
 	fprintf(stderr, "  >> current undo data is \"%s\"\n", u->strdata);
 #endif
-	u->mark_begin_lineno = openfile->current->lineno;
+	u->mark_begin_lineno = line_number(openfile->current);
 	u->mark_begin_x = openfile->current_x;
 	break;
     }
@@ -1440,10 +1482,10 @@ fprintf(stderr, "  >> Updating... action = %d, openfile->last_action = %d, openf
     case REPLACE:
     case PASTE:
 	u->begin = openfile->current_x;
-	u->lineno = openfile->current->lineno;
+	u->lineno = line_number(openfile->current);
 	break;
     case INSERT:
-	u->mark_begin_lineno = openfile->current->lineno;
+	u->mark_begin_lineno = line_number(openfile->current);
 	u->mark_begin_x = openfile->current_x;
 	break;
     case ENTER:
@@ -1569,9 +1611,11 @@ bool do_wrap(filestruct *line)
 	    add_undo(ADD);
 #endif
 	    line_len++;
+	    unshare_line(line);
 	    line->data = charealloc(line->data, line_len + 1);
 	    line->data[line_len - 1] = ' ';
 	    line->data[line_len] = '\0';
+	    invalidate_line(line);
 	    after_break = line->data + wrap_loc;
 	    after_break_len++;
 	    openfile->totsize++;
@@ -1590,7 +1634,7 @@ bool do_wrap(filestruct *line)
 	    /* Delete any leading blanks from the joined-on line. */
 	    while (is_blank_mbchar(&line->data[openfile->current_x]))
 		do_delete();
-	    renumber(line);
+	    renumber_span(line, line);
 	}
     }
 
@@ -1853,8 +1897,9 @@ void justify_format(filestruct *paragraph, size_t skip)
     if (shift > 0) {
 	openfile->totsize -= shift;
 	null_at(&new_paragraph_data, new_end - new_paragraph_data);
-	free(paragraph->data);
+	release_text(paragraph);
 	paragraph->data = new_paragraph_data;
+	invalidate_line(paragraph);
 
 #ifndef NANO_TINY
 	/* Adjust the mark coordinates to compensate for the change in
@@ -1993,16 +2038,16 @@ void backup_lines(filestruct *first_line, size_t par_len)
     size_t i;
 	/* Generic loop variable. */
     size_t current_x_save = openfile->current_x;
-    ssize_t fl_lineno_save = first_line->lineno;
-    ssize_t edittop_lineno_save = openfile->edittop->lineno;
-    ssize_t current_lineno_save = openfile->current->lineno;
+    ssize_t fl_lineno_save = line_number(first_line);
+    ssize_t edittop_lineno_save = line_number(openfile->edittop);
+    ssize_t current_lineno_save = line_number(openfile->current);
 #ifndef NANO_TINY
     bool old_mark_set = openfile->mark_set;
     ssize_t mb_lineno_save = 0;
     size_t mark_begin_x_save = 0;
 
     if (old_mark_set) {
-	mb_lineno_save = openfile->mark_begin->lineno;
+	mb_lineno_save = line_number(openfile->mark_begin);
 	mark_begin_x_save = openfile->mark_begin_x;
     }
 #endif
@@ -2010,8 +2055,8 @@ void backup_lines(filestruct *first_line, size_t par_len)
     /* par_len will be one greater than the number of lines between
      * current and filebot if filebot is the last line in the
      * paragraph. */
-    assert(par_len > 0 && openfile->current->lineno + par_len <=
-				openfile->filebot->lineno + 1);
+    assert(par_len > 0 && line_number(openfile->current) + par_len <=
+				line_number(openfile->filebot) + 1);
 
     /* Move bot down par_len lines to the line after the last line of
      * the paragraph, if there is one. */
@@ -2033,7 +2078,7 @@ void backup_lines(filestruct *first_line, size_t par_len)
 	top = openfile->current->prev;
 #ifndef NANO_TINY
 	if (old_mark_set &&
-		openfile->current->lineno == mb_lineno_save) {
+		line_number(openfile->current) == mb_lineno_save) {
 	    openfile->mark_begin = openfile->current;
 	    openfile->mark_begin_x = mark_begin_x_save;
 	}
@@ -2041,14 +2086,14 @@ void backup_lines(filestruct *first_line, size_t par_len)
     } else
 	top = openfile->current;
     for (i = par_len; i > 0 && top != NULL; i--) {
-	if (top->lineno == fl_lineno_save)
+	if (line_number(top) == fl_lineno_save)
 	    first_line = top;
-	if (top->lineno == edittop_lineno_save)
+	if (line_number(top) == edittop_lineno_save)
 	    openfile->edittop = top;
-	if (top->lineno == current_lineno_save)
+	if (line_number(top) == current_lineno_save)
 	    openfile->current = top;
 #ifndef NANO_TINY
-	if (old_mark_set && top->lineno == mb_lineno_save) {
+	if (old_mark_set && line_number(top) == mb_lineno_save) {
 	    openfile->mark_begin = top;
 	    openfile->mark_begin_x = mark_begin_x_save;
 	}
@@ -2127,7 +2172,7 @@ bool find_paragraph(size_t *const quote, size_t *const par)
     quote_len = quote_length(openfile->current->data);
     current_save = openfile->current;
     do_para_end(FALSE);
-    par_len = openfile->current->lineno - current_save->lineno;
+    par_len = line_number(openfile->current) - line_number(current_save);
 
     /* If we end up past the beginning of the line, it means that we're
      * at the end of the last line of the file, and the line isn't
@@ -2236,8 +2281,8 @@ void do_justify(bool full_justify)
 	/* par_len will be one greater than the number of lines between
 	 * current and filebot if filebot is the last line in the
 	 * paragraph.  Set filebot_inpar to TRUE if this is the case. */
-	filebot_inpar = (openfile->current->lineno + par_len ==
-		openfile->filebot->lineno + 1);
+	filebot_inpar = (line_number(openfile->current) + par_len ==
+		line_number(openfile->filebot) + 1);
 
 	/* If we haven't already done it, move the original paragraph(s)
 	 * to the justify buffer, splice a copy of the original
@@ -2245,7 +2290,8 @@ void do_justify(bool full_justify)
 	 * first_par_line to the first line of the copy. */
 	if (first_par_line == NULL) {
 	    backup_lines(openfile->current, full_justify ?
-		openfile->filebot->lineno - openfile->current->lineno +
+		line_number(openfile->filebot) -
+		line_number(openfile->current) +
 		((openfile->filebot->data[0] != '\0') ? 1 : 0) : par_len);
 	    first_par_line = openfile->current;
 	}
@@ -2298,6 +2344,8 @@ void do_justify(bool full_justify)
 	    next_line_len -= indent_len;
 	    openfile->totsize -= indent_len;
 
+	    unshare_line(openfile->current);
+
 	    /* We're just about to tack the next line onto this one.  If
 	     * this line isn't empty, make sure it ends in a space. */
 	    if (line_len > 0 && openfile->current->data[line_len - 1] != ' ') {
@@ -2312,6 +2360,7 @@ void do_justify(bool full_justify)
 	    openfile->current->data = charealloc(openfile->current->data,
 			line_len + next_line_len + 1);
 	    strcat(openfile->current->data, next_line->data + indent_len);
+	    invalidate_line(openfile->current);
 
 #ifndef NANO_TINY
 	    /* If needed, adjust the coordinates of the mark. */
@@ -2319,6 +2368,9 @@ void do_justify(bool full_justify)
 		openfile->mark_begin = openfile->current;
 		openfile->mark_begin_x += line_len - indent_len;
 	    }
+
+	    move_anchors(next_line, 0, openfile->current,
+			line_len - indent_len);
 #endif
 	    /* Don't destroy edittop! */
 	    if (next_line == openfile->edittop)
@@ -2340,7 +2392,7 @@ void do_justify(bool full_justify)
 	justify_format(openfile->current, quote_len +
 		indent_length(openfile->current->data + quote_len));
 
-	while (par_len > 0 && strlenpt(openfile->current->data) > fill) {
+	while (par_len > 0 && line_width(openfile->current) > fill) {
 	    size_t line_len = strlen(openfile->current->data);
 
 	    indent_len = strlen(indent_string);
@@ -2400,7 +2452,9 @@ void do_justify(bool full_justify)
 		    openfile->totsize--;
 		}
 	    }
+	    unshare_line(openfile->current);
 	    null_at(&openfile->current->data, break_pos);
+	    invalidate_line(openfile->current);
 
 	    /* Go to the next line. */
 	    par_len--;
@@ -2411,16 +2465,16 @@ void do_justify(bool full_justify)
 	 * anymore. */
 	free(indent_string);
 
+	/* Renumber the now-justified paragraph, since both refreshing the
+	 * edit window and finding a paragraph need correct line numbers. */
+	renumber_span(curr_first_par_line, openfile->current);
+
 	/* Go to the next line, if possible.  If there is no next line,
 	 * move to the end of the current line. */
 	if (openfile->current != openfile->filebot) {
 	    openfile->current = openfile->current->next;
 	} else
-	    openfile->current_x = strlen(openfile->current->data);
-
-	/* Renumber the now-justified paragraph, since both refreshing the
-	 * edit window and finding a paragraph need correct line numbers. */
-	renumber(curr_first_par_line);
+	    openfile->current_x = line_length(openfile->current);
 
 	/* We've just finished justifying the paragraph.  If we're not
 	 * justifying the entire file, break out of the loop.
@@ -2854,7 +2908,7 @@ const char *do_alt_speller(char *tempfile_name)
     int alt_spell_status;
     size_t current_x_save = openfile->current_x;
     size_t pww_save = openfile->placewewant;
-    ssize_t lineno_save = openfile->current->lineno;
+    ssize_t lineno_save = line_number(openfile->current);
     bool was_at_eol = (openfile->current->data[openfile->current_x] == '\0');
     struct stat spellfileinfo;
     time_t timestamp;
@@ -2922,7 +2976,7 @@ const char *do_alt_speller(char *tempfile_name)
 	filestruct *top, *bot;
 	size_t top_x, bot_x;
 	bool right_side_up;
-	ssize_t was_mark_lineno = openfile->mark_begin->lineno;
+	ssize_t was_mark_lineno = line_number(openfile->mark_begin);
 
 	openfile->mark_set = FALSE;
 
@@ -2948,7 +3002,7 @@ const char *do_alt_speller(char *tempfile_name)
     /* Go back to the old position. */
     goto_line_posx(lineno_save, current_x_save);
     if (was_at_eol || openfile->current_x > strlen(openfile->current->data))
-	openfile->current_x = strlen(openfile->current->data);
+	openfile->current_x = line_length(openfile->current);
     openfile->placewewant = pww_save;
     adjust_viewport(STATIONARY);
 
@@ -2998,7 +3052,7 @@ void do_spell(void)
 	status = write_marked_file(temp, temp_file, TRUE, OVERWRITE);
     else
 #endif
-	status = write_file(temp, temp_file, TRUE, OVERWRITE, FALSE);
+	status = write_file(temp, temp_file, TRUE, OVERWRITE, FALSE, NULL);
 
     if (!status) {
 	statusline(ALERT, _("Error writing temp file: %s"), strerror(errno));
@@ -3373,7 +3427,7 @@ void do_formatter(void)
     bool status;
     FILE *temp_file;
     int format_status;
-    ssize_t lineno_save = openfile->current->lineno;
+    ssize_t lineno_save = line_number(openfile->current);
     size_t current_x_save = openfile->current_x;
     size_t pww_save = openfile->placewewant;
     bool was_at_eol = (openfile->current->data[openfile->current_x] == '\0');
@@ -3398,7 +3452,7 @@ void do_formatter(void)
     /* We're not supporting partial formatting, oi vey. */
     openfile->mark_set = FALSE;
 #endif
-    status = write_file(temp, temp_file, TRUE, OVERWRITE, FALSE);
+    status = write_file(temp, temp_file, TRUE, OVERWRITE, FALSE, NULL);
 
     if (!status) {
 	statusline(ALERT, _("Error writing temp file: %s"), strerror(errno));
@@ -3457,7 +3511,7 @@ void do_formatter(void)
 	/* Restore the cursor position. */
 	goto_line_posx(lineno_save, current_x_save);
 	if (was_at_eol || openfile->current_x > strlen(openfile->current->data))
-	    openfile->current_x = strlen(openfile->current->data);
+	    openfile->current_x = line_length(openfile->current);
 	openfile->placewewant = pww_save;
 	adjust_viewport(STATIONARY);
 
@@ -3497,57 +3551,51 @@ void do_formatter(void)
 void do_wordlinechar_count(void)
 {
     size_t words = 0, chars = 0;
-    ssize_t nlines = 0;
-    size_t current_x_save = openfile->current_x;
-    size_t pww_save = openfile->placewewant;
-    filestruct *current_save = openfile->current;
+    ssize_t nlines;
     bool old_mark_set = openfile->mark_set;
-    filestruct *top, *bot;
-    size_t top_x, bot_x;
+    rangestruct range;
+    filestruct *line;
 
-    /* If the mark is on, partition the buffer so that it
-     * contains only the marked text, and turn the mark off. */
-    if (old_mark_set) {
-	mark_order((const filestruct **)&top, &top_x,
-			(const filestruct **)&bot, &bot_x, NULL);
-	filepart = partition_filestruct(top, top_x, bot, bot_x);
-	openfile->mark_set = FALSE;
-    }
-
-    /* Start at the top of the file. */
-    openfile->current = openfile->fileage;
-    openfile->current_x = 0;
-    openfile->placewewant = 0;
+    /* If the mark is on, count just the marked text, else the whole buffer. */
+    if (old_mark_set)
+	mark_range(&range);
+    else {
+	range.top = openfile->fileage;
+	range.top_x = 0;
+	range.bot = openfile->filebot;
+	range.bot_x = strlen(openfile->filebot->data);
+    }
+
+    /* Go through the text of the range, counting every character, and
+     * counting a word whenever a word character (where punctuation counts
+     * as part of a word, as "wc -w" does) follows a separator or begins
+     * a line. */
+    for (line = range.top; ; line = line->next) {
+	size_t x = (line == range.top) ? range.top_x : 0;
+	size_t end = (line == range.bot) ? range.bot_x : strlen(line->data);
+	bool in_word = FALSE;
+
+	while (x < end) {
+	    if (!is_word_mbchar(line->data + x, TRUE))
+		in_word = FALSE;
+	    else if (!in_word) {
+		in_word = TRUE;
+		words++;
+	    }
 
-    /* Keep moving to the next word (counting punctuation characters as
-     * part of a word, as "wc -w" does), without updating the screen,
-     * until we reach the end of the file, incrementing the total word
-     * count whenever we're on a word just before moving. */
-    while (openfile->current != openfile->filebot ||
-	openfile->current->data[openfile->current_x] != '\0') {
-	if (do_next_word(TRUE, FALSE))
-	    words++;
-    }
+	    x = move_mbright(line->data, x);
+	    chars++;
+	}
 
-    /* Get the total line and character counts, as "wc -l"  and "wc -c"
-     * do, but get the latter in multibyte characters. */
-    if (old_mark_set) {
-	nlines = openfile->filebot->lineno - openfile->fileage->lineno + 1;
-	chars = get_totsize(openfile->fileage, openfile->filebot);
+	if (line == range.bot)
+	    break;
 
-	/* Unpartition the buffer so that it contains all the text
-	 * again, and turn the mark back on. */
-	unpartition_filestruct(&filepart);
-	openfile->mark_set = TRUE;
-    } else {
-	nlines = openfile->filebot->lineno;
-	chars = openfile->totsize;
+	/* Count the newline at the end of this line. */
+	chars++;
     }
 
-    /* Restore where we were. */
-    openfile->current = current_save;
-    openfile->current_x = current_x_save;
-    openfile->placewewant = pww_save;
+    /* Get the total line count, as "wc -l" does. */
+    nlines = line_number(range.bot) - line_number(range.top) + 1;
 
     /* Display the total word, line, and character counts on the statusbar. */
     statusline(HUSH, _("%sWords: %lu  Lines: %ld  Chars: %lu"), old_mark_set ?
@@ -458,7 +458,7 @@ void new_magicline(void)
     openfile->totsize++;
 }
 
-#if !defined(NANO_TINY) || defined(ENABLE_HELP)
+#ifdef ENABLE_HELP
 /* Remove the magicline from filebot, if there is one and it isn't the
  * only line in the file.  Assume that edittop and current are not at
  * filebot. */
@@ -467,6 +467,10 @@ void remove_magicline(void)
     if (openfile->filebot->data[0] == '\0' &&
 		openfile->filebot != openfile->fileage) {
 	openfile->filebot = openfile->filebot->prev;
+#ifndef NANO_TINY
+	move_anchors(openfile->filebot->next, 0, openfile->filebot,
+			strlen(openfile->filebot->data));
+#endif
 	free_filestruct(openfile->filebot->next);
 	openfile->filebot->next = NULL;
 	openfile->totsize--;
@@ -483,9 +487,12 @@ void remove_magicline(void)
 void mark_order(const filestruct **top, size_t *top_x, const filestruct
 	**bot, size_t *bot_x, bool *right_side_up)
 {
-    if ((openfile->current->lineno == openfile->mark_begin->lineno &&
+    ssize_t current_lineno = line_number(openfile->current);
+    ssize_t mark_lineno = line_number(openfile->mark_begin);
+
+    if ((current_lineno == mark_lineno &&
 		openfile->current_x > openfile->mark_begin_x) ||
-		openfile->current->lineno > openfile->mark_begin->lineno) {
+		current_lineno > mark_lineno) {
 	*top = openfile->mark_begin;
 	*top_x = openfile->mark_begin_x;
 	*bot = openfile->current;
@@ -502,19 +509,31 @@ void mark_order(const filestruct **top, size_t *top_x, const filestruct
     }
 }
 
+/* Set the given range to the marked region, from its top to its bottom. */
+void mark_range(rangestruct *range)
+{
+    mark_order((const filestruct **)&range->top, &range->top_x,
+		(const filestruct **)&range->bot, &range->bot_x, NULL);
+}
+#endif /* !NANO_TINY */
+
 /* Given a line number, return a pointer to the corresponding struct. */
 filestruct *fsfromline(ssize_t lineno)
 {
-    filestruct *f = openfile->current;
+    filestruct *f = closest_indexed_line(lineno);
+
+    /* Without a usable index, start from the current line. */
+    if (f == NULL)
+	f = openfile->current;
 
-    if (lineno <= openfile->current->lineno)
-	while (f->lineno != lineno && f->prev != NULL)
+    if (lineno <= line_number(f))
+	while (line_number(f) != lineno && f->prev != NULL)
 	    f = f->prev;
     else
-	while (f->lineno != lineno && f->next != NULL)
+	while (line_number(f) != lineno && f->next != NULL)
 	    f = f->next;
 
-    if (f->lineno != lineno) {
+    if (line_number(f) != lineno) {
 	statusline(ALERT, _("Internal error: can't match line %ld.  "
 			"Please save your work."), (long)lineno);
 	return NULL;
@@ -522,8 +541,133 @@ filestruct *fsfromline(ssize_t lineno)
 
     return f;
 }
+
+#ifndef NANO_TINY
+/* Determine which bytes occur in the given line, and which of them occur
+ * at the start of a word, unless this is already known. */
+void index_line(filestruct *line)
+{
+    const unsigned char *ptr = (const unsigned char *)line->data;
+    bool word_start = TRUE;
+
+    if (line->charmap != 0)
+	return;
+
+    line->charmap = 1;
+    line->wordmap = 1;
+
+    for (; *ptr != '\0'; ptr++) {
+	unsigned int bit = CHARMAP_BIT(*ptr);
+
+	line->charmap |= bit;
+	if (word_start)
+	    line->wordmap |= bit;
+
+	/* Count any non-ASCII byte as a separator, so that the map errs on
+	 * the side of too many word starts rather than too few. */
+	word_start = (*ptr >= 0x80 || !isalnum(*ptr));
+    }
+}
+
+/* Return FALSE when the given line surely contains none of the bytes in
+ * mask (made of CHARMAP_BIT()s), and TRUE when it might contain one.  When
+ * word_start is TRUE, look only at the bytes that begin a word. */
+bool line_may_contain(filestruct *line, unsigned int mask,
+	bool word_start)
+{
+    index_line(line);
+
+    return (((word_start ? line->wordmap : line->charmap) & mask & ~1U) != 0);
+}
 #endif /* !NANO_TINY */
 
+/* Forget what is known about the text of the given line, because this
+ * text has just been changed. */
+void invalidate_line(filestruct *line)
+{
+    line->length = NOT_KNOWN;
+    line->width = NOT_KNOWN;
+#ifndef NANO_TINY
+    line->charmap = 0;
+#endif
+}
+
+/* Return the length in bytes of the text of the given line, measuring it
+ * only when it is not known since the last change. */
+size_t line_length(filestruct *line)
+{
+    size_t length;
+
+    if (line->length != NOT_KNOWN) {
+	/* In a debug build, check that the cached length is still right. */
+	assert(line->length == strlen(line->data));
+	return line->length;
+    }
+
+    length = strlen(line->data);
+
+    if (length < NOT_KNOWN)
+	line->length = length;
+
+    return length;
+}
+
+/* Return the width in columns of the text of the given line, measuring it
+ * only when it is not known since the last change.  (The width depends on
+ * the tab size too, but that changes only for the help viewer, which has
+ * a buffer of its own.) */
+size_t line_width(filestruct *line)
+{
+    size_t width;
+
+    if (line->width != NOT_KNOWN) {
+	assert(line->width == strlenpt(line->data));
+	return line->width;
+    }
+
+    width = strlenpt(line->data);
+
+    if (width < NOT_KNOWN)
+	line->width = width;
+
+    return width;
+}
+
+/* Return the number of the given line of the current buffer, first
+ * applying to it the line shifts that were recorded since it was last
+ * numbered. */
+ssize_t line_number(filestruct *line)
+{
+    return line_number_in(openfile, line);
+}
+
+/* Return the number of the given line of the given buffer, which need
+ * not be the current one: the shifts and the epoch must be those of
+ * the buffer that the line belongs to. */
+ssize_t line_number_in(openfilestruct *buffer, filestruct *line)
+{
+    size_t now, shift;
+
+    if (line->epoch == 0)
+	return line->lineno;
+
+    now = buffer->shift_base + buffer->shift_count;
+
+    if (line->epoch == now)
+	return line->lineno;
+
+    shift = (line->epoch > buffer->shift_base) ?
+		line->epoch - buffer->shift_base : 0;
+
+    for (; shift < buffer->shift_count; shift++)
+	if (line->lineno >= buffer->shifts[shift].from)
+	    line->lineno += buffer->shifts[shift].delta;
+
+    line->epoch = now;
+
+    return line->lineno;
+}
+
 /* Count the number of characters from begin to end, and return it. */
 size_t get_totsize(const filestruct *begin, const filestruct *end)
 {
@@ -49,6 +49,8 @@ static bool waiting_mode = TRUE;
 	/* Whether getting a character will wait for a key to be pressed. */
 static int statusblank = 0;
 	/* The number of keystrokes left before we blank the statusbar. */
+static bool map_is_current = FALSE;
+	/* Whether the screen map was just filled in by a full refresh. */
 #ifdef USING_OLD_NCURSES
 static bool seen_wide = FALSE;
 	/* Whether we've seen a multicolumn character in the current line. */
@@ -1775,8 +1777,10 @@ void blank_edit(void)
 {
     int row;
 
-    for (row = 0; row < editwinrows; row++)
+    for (row = 0; row < editwinrows; row++) {
 	blank_row(edit, row, 0, COLS);
+	unmap_row(row);
+    }
 }
 
 /* Blank the first line of the bottom portion of the window. */
@@ -2295,16 +2299,29 @@ void place_the_cursor(bool forreal)
     if (ISSET(SOFTWRAP)) {
 	filestruct *line = openfile->edittop;
 
-	row -= (openfile->firstcolumn / editwincols);
+	/* Right after a full refresh, the screen map tells on which row
+	 * current starts; otherwise count the rows from edittop onward. */
+	if (map_is_current) {
+	    while (row < editwinrows && screenmap[row].line != openfile->current)
+		row++;
+	}
+
+	if (map_is_current && row < editwinrows &&
+				xpt >= screenmap[row].leftedge)
+	    row += (xpt - screenmap[row].leftedge) / editwincols;
+	else {
+	    row = -(ssize_t)(openfile->firstcolumn / editwincols);
+
+	    /* Calculate how many rows the lines from edittop to current use. */
+	    while (line != NULL && line != openfile->current) {
+		row += line_width(line) / editwincols + 1;
+		line = line->next;
+	    }
 
-	/* Calculate how many rows the lines from edittop to current use. */
-	while (line != NULL && line != openfile->current) {
-	    row += strlenpt(line->data) / editwincols + 1;
-	    line = line->next;
+	    /* Add the number of wraps in the current line before the cursor. */
+	    row += xpt / editwincols;
 	}
 
-	/* Add the number of wraps in the current line before the cursor. */
-	row += xpt / editwincols;
 	col = xpt % editwincols;
 
 	/* If the cursor ought to be in column zero, nudge it there. */
@@ -2315,7 +2332,7 @@ void place_the_cursor(bool forreal)
     } else
 #endif
     {
-	row = openfile->current->lineno - openfile->edittop->lineno;
+	row = line_number(openfile->current) - line_number(openfile->edittop);
 	col = xpt - get_page_start(xpt);
     }
 
@@ -2326,6 +2343,35 @@ void place_the_cursor(bool forreal)
 	openfile->current_y = row;
 }
 
+/* Record in the screen map that the given line is shown on the given row
+ * of the edit window, starting from column leftedge. */
+void map_row(int row, filestruct *fileptr, size_t leftedge)
+{
+    screenmap[row].line = fileptr;
+    screenmap[row].start = actual_x(fileptr->data, leftedge);
+    screenmap[row].end = actual_x(fileptr->data, leftedge + editwincols);
+    screenmap[row].leftedge = leftedge;
+}
+
+/* Record in the screen map that the given row of the edit window is blank. */
+void unmap_row(int row)
+{
+    screenmap[row].line = NULL;
+    screenmap[row].start = 0;
+    screenmap[row].end = 0;
+    screenmap[row].leftedge = 0;
+}
+
+/* Return the entry of the screen map for the given row of the edit window,
+ * or NULL when the row is outside the window or shows no text. */
+const screenrow *mapped_row(int row)
+{
+    if (row < 0 || row >= editwinrows || screenmap[row].line == NULL)
+	return NULL;
+
+    return &screenmap[row];
+}
+
 /* edit_draw() takes care of the job of actually painting a line into
  * the edit window.  fileptr is the line to be painted, at row row of
  * the window.  converted is the actual string to be written to the
@@ -2360,7 +2406,8 @@ void edit_draw(filestruct *fileptr, const char *converted,
 	    mvwprintw(edit, row, 0, "%*s", margin - 1, " ");
 	else
 #endif
-	    mvwprintw(edit, row, 0, "%*ld", margin - 1, (long)fileptr->lineno);
+	    mvwprintw(edit, row, 0, "%*ld", margin - 1,
+				(long)line_number(fileptr));
 	wattroff(edit, interface_color_pair[LINE_NUMBER]);
     }
 #endif
@@ -2382,10 +2429,6 @@ void edit_draw(filestruct *fileptr, const char *converted,
     if (openfile->colorstrings != NULL && !ISSET(NO_COLOR_SYNTAX)) {
 	const colortype *varnish = openfile->colorstrings;
 
-	/* If there are multiline regexes, make sure there is a cache. */
-	if (openfile->syntax->nmultis > 0)
-	    alloc_multidata_if_needed(fileptr);
-
 	/* Iterate through all the coloring regexes. */
 	for (; varnish != NULL; varnish = varnish->next) {
 	    size_t index = 0;
@@ -2461,18 +2504,18 @@ void edit_draw(filestruct *fileptr, const char *converted,
 	    /* Second case: varnish is a multiline expression. */
 
 	    /* Assume nothing gets painted until proven otherwise below. */
-	    fileptr->multidata[varnish->id] = CNONE;
+	    set_multi_state(fileptr, varnish->id, CNONE);
 
 	    /* First check the multidata of the preceding line -- it tells
 	     * us about the situation so far, and thus what to do here. */
-	    if (start_line != NULL && start_line->multidata != NULL) {
-		if (start_line->multidata[varnish->id] == CWHOLELINE ||
-			start_line->multidata[varnish->id] == CENDAFTER ||
-			start_line->multidata[varnish->id] == CWOULDBE)
+	    if (start_line != NULL) {
+		if (multi_state(start_line, varnish->id) == CWHOLELINE ||
+			multi_state(start_line, varnish->id) == CENDAFTER ||
+			multi_state(start_line, varnish->id) == CWOULDBE)
 		    goto seek_an_end;
-		if (start_line->multidata[varnish->id] == CNONE ||
-			start_line->multidata[varnish->id] == CBEGINBEFORE ||
-			start_line->multidata[varnish->id] == CSTARTENDHERE)
+		if (multi_state(start_line, varnish->id) == CNONE ||
+			multi_state(start_line, varnish->id) == CBEGINBEFORE ||
+			multi_state(start_line, varnish->id) == CSTARTENDHERE)
 		    goto step_two;
 	    }
 
@@ -2496,9 +2539,8 @@ void edit_draw(filestruct *fileptr, const char *converted,
 
 	    /* If a found start has been qualified as an end earlier,
 	     * believe it and skip to the next step. */
-	    if (start_line->multidata != NULL &&
-			(start_line->multidata[varnish->id] == CBEGINBEFORE ||
-			start_line->multidata[varnish->id] == CSTARTENDHERE))
+	    if (multi_state(start_line, varnish->id) == CBEGINBEFORE ||
+			multi_state(start_line, varnish->id) == CSTARTENDHERE)
 		goto step_two;
 
 	    /* Is there an uncomplemented start on the found line? */
@@ -2535,14 +2577,14 @@ void edit_draw(filestruct *fileptr, const char *converted,
 
 	    /* If there is no end, there is nothing to paint. */
 	    if (end_line == NULL) {
-		fileptr->multidata[varnish->id] = CWOULDBE;
+		set_multi_state(fileptr, varnish->id, CWOULDBE);
 		goto tail_of_loop;
 	    }
 
 	    /* If the end is on a later line, paint whole line, and be done. */
 	    if (end_line != fileptr) {
 		mvwaddnstr(edit, row, margin, converted, -1);
-		fileptr->multidata[varnish->id] = CWHOLELINE;
+		set_multi_state(fileptr, varnish->id, CWHOLELINE);
 		goto tail_of_loop;
 	    }
 
@@ -2552,7 +2594,7 @@ void edit_draw(filestruct *fileptr, const char *converted,
 						endmatch.rm_eo) - from_col);
 		mvwaddnstr(edit, row, margin, converted, paintlen);
 	    }
-	    fileptr->multidata[varnish->id] = CBEGINBEFORE;
+	    set_multi_state(fileptr, varnish->id, CBEGINBEFORE);
 
   step_two:
 	    /* Second step: look for starts on this line, but begin
@@ -2590,7 +2632,7 @@ void edit_draw(filestruct *fileptr, const char *converted,
 			mvwaddnstr(edit, row, margin + start_col,
 						thetext, paintlen);
 
-			fileptr->multidata[varnish->id] = CSTARTENDHERE;
+			set_multi_state(fileptr, varnish->id, CSTARTENDHERE);
 		    }
 		    index = endmatch.rm_eo;
 		    /* If both start and end match are anchors, advance. */
@@ -2612,13 +2654,13 @@ void edit_draw(filestruct *fileptr, const char *converted,
 
 		/* If there is no end, we're done with this regex. */
 		if (end_line == NULL) {
-		    fileptr->multidata[varnish->id] = CWOULDBE;
+		    set_multi_state(fileptr, varnish->id, CWOULDBE);
 		    break;
 		}
 
 		/* Paint the rest of the line, and we're done. */
 		mvwaddnstr(edit, row, margin + start_col, thetext, -1);
-		fileptr->multidata[varnish->id] = CENDAFTER;
+		set_multi_state(fileptr, varnish->id, CENDAFTER);
 		break;
 	    }
   tail_of_loop:
@@ -2631,11 +2673,11 @@ void edit_draw(filestruct *fileptr, const char *converted,
     /* If the mark is on, and fileptr is at least partially selected, we
      * need to paint it. */
     if (openfile->mark_set &&
-		(fileptr->lineno <= openfile->mark_begin->lineno ||
-		fileptr->lineno <= openfile->current->lineno) &&
-		(fileptr->lineno >= openfile->mark_begin->lineno ||
-		fileptr->lineno >= openfile->current->lineno)) {
-	const filestruct *top, *bot;
+		(line_number(fileptr) <= line_number(openfile->mark_begin) ||
+		line_number(fileptr) <= line_number(openfile->current)) &&
+		(line_number(fileptr) >= line_number(openfile->mark_begin) ||
+		line_number(fileptr) >= line_number(openfile->current))) {
+	filestruct *top, *bot;
 	    /* The lines where the marked region begins and ends. */
 	size_t top_x, bot_x;
 	    /* The x positions where the marked region begins and ends. */
@@ -2646,11 +2688,12 @@ void edit_draw(filestruct *fileptr, const char *converted,
 	int paintlen = -1;
 	    /* The number of characters to paint.  Negative means "all". */
 
-	mark_order(&top, &top_x, &bot, &bot_x, NULL);
+	mark_order((const filestruct **)&top, &top_x,
+			(const filestruct **)&bot, &bot_x, NULL);
 
-	if (top->lineno < fileptr->lineno || top_x < from_x)
+	if (line_number(top) < line_number(fileptr) || top_x < from_x)
 	    top_x = from_x;
-	if (bot->lineno > fileptr->lineno || bot_x > till_x)
+	if (line_number(bot) > line_number(fileptr) || bot_x > till_x)
 	    bot_x = till_x;
 
 	/* Only paint if the marked part of the line is on this page. */
@@ -2698,7 +2741,7 @@ int update_line(filestruct *fileptr, size_t index)
 	return update_softwrapped_line(fileptr);
 #endif
 
-    row = fileptr->lineno - openfile->edittop->lineno;
+    row = line_number(fileptr) - line_number(openfile->edittop);
 
     /* If the line is offscreen, don't even try to display it. */
     if (row < 0 || row >= editwinrows) {
@@ -2723,9 +2766,11 @@ int update_line(filestruct *fileptr, size_t index)
     edit_draw(fileptr, converted, row, from_col);
     free(converted);
 
+    map_row(row, fileptr, from_col);
+
     if (from_col > 0)
 	mvwaddch(edit, row, margin, '$');
-    if (strlenpt(fileptr->data) > from_col + editwincols)
+    if (line_width(fileptr) > from_col + editwincols)
 	mvwaddch(edit, row, COLS - 1, '$');
 
     return 1;
@@ -2757,7 +2802,7 @@ int update_softwrapped_line(filestruct *fileptr)
 
     /* Find out on which screen row the target line should be shown. */
     while (line != fileptr && line != NULL) {
-	row += (strlenpt(line->data) / editwincols) + 1;
+	row += (line_width(line) / editwincols) + 1;
 	line = line->next;
     }
 
@@ -2768,7 +2813,7 @@ int update_softwrapped_line(filestruct *fileptr)
 	return 0;
     }
 
-    full_length = strlenpt(fileptr->data);
+    full_length = line_width(fileptr);
     starting_row = row;
 
     while (from_col <= full_length && row < editwinrows) {
@@ -2776,9 +2821,11 @@ int update_softwrapped_line(filestruct *fileptr)
 
 	/* Convert the chunk to its displayable form and draw it. */
 	converted = display_string(fileptr->data, from_col, editwincols, TRUE);
-	edit_draw(fileptr, converted, row++, from_col);
+	edit_draw(fileptr, converted, row, from_col);
 	free(converted);
 
+	map_row(row++, fileptr, from_col);
+
 	from_col += editwincols;
     }
 
@@ -2826,7 +2873,7 @@ int go_back_chunks(int nrows, filestruct **line, size_t *leftedge)
 		break;
 
 	    *line = (*line)->prev;
-	    current_chunk = strlenpt((*line)->data) / editwincols;
+	    current_chunk = line_width(*line) / editwincols;
 	}
 
 	/* Only change leftedge when we actually could move. */
@@ -2855,7 +2902,7 @@ int go_forward_chunks(int nrows, filestruct **line, size_t *leftedge)
 #ifndef NANO_TINY
     if (ISSET(SOFTWRAP)) {
 	size_t current_chunk = (*leftedge) / editwincols;
-	size_t last_chunk = strlenpt((*line)->data) / editwincols;
+	size_t last_chunk = line_width(*line) / editwincols;
 
 	/* Advance through the requested number of chunks. */
 	for (i = nrows; i > 0; i--) {
@@ -2869,7 +2916,7 @@ int go_forward_chunks(int nrows, filestruct **line, size_t *leftedge)
 
 	    *line = (*line)->next;
 	    current_chunk = 0;
-	    last_chunk = strlenpt((*line)->data) / editwincols;
+	    last_chunk = line_width(*line) / editwincols;
 	}
 
 	/* Only change leftedge when we actually could move. */
@@ -2894,11 +2941,11 @@ bool less_than_a_screenful(size_t was_lineno, size_t was_leftedge)
 	size_t leftedge = (xplustabs() / editwincols) * editwincols;
 	int rows_left = go_back_chunks(editwinrows - 1, &line, &leftedge);
 
-	return (rows_left > 0 || line->lineno < was_lineno ||
-		(line->lineno == was_lineno && leftedge <= was_leftedge));
+	return (rows_left > 0 || line_number(line) < was_lineno ||
+		(line_number(line) == was_lineno && leftedge <= was_leftedge));
     } else
 #endif
-	return (openfile->current->lineno - was_lineno < editwinrows);
+	return (line_number(openfile->current) - was_lineno < editwinrows);
 }
 
 /* Scroll the edit window in the given direction and the given number of rows,
@@ -2907,6 +2954,7 @@ void edit_scroll(scroll_dir direction, int nrows)
 {
     filestruct *line;
     size_t leftedge;
+    int row;
 
     /* Part 1: nrows is the number of rows we're going to scroll the text of
      * the edit window. */
@@ -2939,6 +2987,19 @@ void edit_scroll(scroll_dir direction, int nrows)
     wscrl(edit, (direction == UPWARD) ? -nrows : nrows);
     scrollok(edit, FALSE);
 
+    /* Scroll the screen map along, and forget the rows that became blank. */
+    if (direction == UPWARD) {
+	memmove(screenmap + nrows, screenmap,
+			(editwinrows - nrows) * sizeof(screenrow));
+	for (row = 0; row < nrows; row++)
+	    unmap_row(row);
+    } else {
+	memmove(screenmap, screenmap + nrows,
+			(editwinrows - nrows) * sizeof(screenrow));
+	for (row = editwinrows - nrows; row < editwinrows; row++)
+	    unmap_row(row);
+    }
+
     /* Part 2: nrows is now the number of rows in the scrolled region of the
      * edit window that we need to draw. */
 
@@ -2995,12 +3056,14 @@ bool current_is_above_screen(void)
     if (ISSET(SOFTWRAP))
 	/* The cursor is above screen when current[current_x] is before edittop
 	 * at column firstcolumn. */
-	return (openfile->current->lineno < openfile->edittop->lineno ||
-		(openfile->current->lineno == openfile->edittop->lineno &&
+	return (line_number(openfile->current) <
+				line_number(openfile->edittop) ||
+		(openfile->current == openfile->edittop &&
 		xplustabs() < openfile->firstcolumn));
     else
 #endif
-	return (openfile->current->lineno < openfile->edittop->lineno);
+	return (line_number(openfile->current) <
+				line_number(openfile->edittop));
 }
 
 /* Return TRUE if current[current_x] is below the bottom of the screen, and
@@ -3015,13 +3078,13 @@ bool current_is_below_screen(void)
 	/* If current[current_x] is more than a screen's worth of lines after
 	 * edittop at column firstcolumn, it's below the screen. */
 	return (go_forward_chunks(editwinrows - 1, &line, &leftedge) == 0 &&
-			(line->lineno < openfile->current->lineno ||
-			(line->lineno == openfile->current->lineno &&
+			(line_number(line) < line_number(openfile->current) ||
+			(line_number(line) == line_number(openfile->current) &&
 			leftedge < (xplustabs() / editwincols) * editwincols)));
     } else
 #endif
-	return (openfile->current->lineno >=
-			openfile->edittop->lineno + editwinrows);
+	return (line_number(openfile->current) >=
+			line_number(openfile->edittop) + editwinrows);
 }
 
 /* Return TRUE if current[current_x] is offscreen relative to edittop, and
@@ -3054,7 +3117,7 @@ void edit_redraw(filestruct *old_current)
 	while (line != openfile->current) {
 	    update_line(line, 0);
 
-	    line = (line->lineno > openfile->current->lineno) ?
+	    line = (line_number(line) > line_number(openfile->current)) ?
 			line->prev : line->next;
 	}
     } else
@@ -3089,13 +3152,13 @@ void edit_refresh(void)
     if (current_is_offscreen()) {
 #ifdef DEBUG
 	fprintf(stderr, "edit-refresh: line = %ld, edittop = %ld and editwinrows = %d\n",
-		(long)openfile->current->lineno, (long)openfile->edittop->lineno, editwinrows);
+		(long)line_number(openfile->current), (long)line_number(openfile->edittop), editwinrows);
 #endif
 	adjust_viewport((focusing || !ISSET(SMOOTH_SCROLL)) ? CENTERING : STATIONARY);
     }
 
 #ifdef DEBUG
-    fprintf(stderr, "edit-refresh: now edittop = %ld\n", (long)openfile->edittop->lineno);
+    fprintf(stderr, "edit-refresh: now edittop = %ld\n", (long)line_number(openfile->edittop));
 #endif
 
     line = openfile->edittop;
@@ -3108,10 +3171,14 @@ void edit_refresh(void)
 	line = line->next;
     }
 
-    while (row < editwinrows)
-	blank_row(edit, row++, 0, COLS);
+    while (row < editwinrows) {
+	blank_row(edit, row, 0, COLS);
+	unmap_row(row++);
+    }
 
+    map_is_current = TRUE;
     place_the_cursor(TRUE);
+    map_is_current = FALSE;
     wnoutrefresh(edit);
 
     refresh_needed = FALSE;
@@ -3143,7 +3210,7 @@ void adjust_viewport(update_type manner)
     go_back_chunks(goal, &openfile->edittop, &openfile->firstcolumn);
 
 #ifdef DEBUG
-    fprintf(stderr, "adjust_viewport(): setting edittop to lineno %ld\n", (long)openfile->edittop->lineno);
+    fprintf(stderr, "adjust_viewport(): setting edittop to lineno %ld\n", (long)line_number(openfile->edittop));
 #endif
 }
 
@@ -3199,7 +3266,7 @@ void do_cursorpos(bool force)
 {
     char saved_byte;
     size_t sum, cur_xpt = xplustabs() + 1;
-    size_t cur_lenpt = strlenpt(openfile->current->data) + 1;
+    size_t cur_lenpt = line_width(openfile->current) + 1;
     int linepct, colpct, charpct;
 
     /* If the showing needs to be suppressed, don't suppress it next time. */
@@ -3224,14 +3291,15 @@ void do_cursorpos(bool force)
 	sum--;
 
     /* Display the current cursor position on the statusbar. */
-    linepct = 100 * openfile->current->lineno / openfile->filebot->lineno;
+    linepct = 100 * line_number(openfile->current) /
+				line_number(openfile->filebot);
     colpct = 100 * cur_xpt / cur_lenpt;
     charpct = (openfile->totsize == 0) ? 0 : 100 * sum / openfile->totsize;
 
     statusline(HUSH,
 	_("line %ld/%ld (%d%%), col %lu/%lu (%d%%), char %lu/%lu (%d%%)"),
-	(long)openfile->current->lineno,
-	(long)openfile->filebot->lineno, linepct,
+	(long)line_number(openfile->current),
+	(long)line_number(openfile->filebot), linepct,
 	(unsigned long)cur_xpt, (unsigned long)cur_lenpt, colpct,
 	(unsigned long)sum, (unsigned long)openfile->totsize, charpct);
 